@@ -3,12 +3,13 @@
 #include <fcntl.h>
 #include <unistd.h>
 
-int main()
+int main(int argc, char *argv[])
 {
     int fd;
+    const char *path = argc > 1 ? argv[1] : "/dev/dht-0";
     unsigned char data[2]; // data[0]=湿度, data[1]=温度
 
-    fd = open("/dev/dht11", O_RDONLY);
+    fd = open(path, O_RDONLY);
     if (fd < 0)
     {
         perror("Open device failed");
@@ -24,7 +25,7 @@ int main()
         }
         else
         {
-            printf("Read failed (checksum or timeout)\n");
+            perror("Read failed"); // ETIMEDOUT: 超时，EBADMSG: 校验和错误
         }
         sleep(2); // DHT11 采样间隔建议大于1秒
     }
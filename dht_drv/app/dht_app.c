@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+// 必须与驱动层保持一致
+#define DHT_IOC_MAGIC 'H'
+#define DHT_IOC_SET_FORMAT _IOW(DHT_IOC_MAGIC, 1, uint32_t)
+#define DHT_FMT_STATUS 2
+
+#define DHT_STATUS_VERSION 1
+#define DHT_STATUS_VALID (1 << 0)
+
+struct dht_status
+{
+    uint16_t version;
+    uint16_t size;
+    uint32_t flags;
+    uint64_t timestamp_ns;
+    uint32_t age_ms;      // 距离最近一次成功测量的时间
+    uint32_t failures;    // 之后连续失败的采集次数
+    int32_t humidity;     // 0.001 %RH
+    int32_t temperature;  // 0.001 °C
+    int32_t last_err;
+    uint32_t seq;
+};
+
+/* 从 /sys/class/dht/dht-N/model 读取型号，失败时返回 "unknown" */
+static const char *read_model(const char *path, char *buf, size_t size)
+{
+    char attr[128];
+    const char *name = strrchr(path, '/');
+    ssize_t n;
+    int fd;
+
+    snprintf(attr, sizeof(attr), "/sys/class/dht/%s/model", name ? name + 1 : path);
+    fd = open(attr, O_RDONLY);
+    if (fd < 0)
+        return "unknown";
+    n = read(fd, buf, size - 1);
+    close(fd);
+    if (n <= 0)
+        return "unknown";
+    buf[n] = '\0';
+    buf[strcspn(buf, "\n")] = '\0';
+    return buf;
+}
+
+int main(int argc, char *argv[])
+{
+    int fd;
+    const char *path = argc > 1 ? argv[1] : "/dev/dht-0";
+    char model[16];
+    struct dht_status st;
+    uint32_t format = DHT_FMT_STATUS;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("Open device failed");
+        return -1;
+    }
+
+    // 本 fd 的 read() 改为返回状态记录
+    if (ioctl(fd, DHT_IOC_SET_FORMAT, &format) < 0)
+    {
+        perror("Set format failed");
+        close(fd);
+        return -1;
+    }
+    printf("%s: %s\n", path, read_model(path, model, sizeof(model)));
+
+    while (1)
+    {
+        // 状态记录对所有型号格式相同，读取不会阻塞
+        int ret = read(fd, &st, sizeof(st));
+        if (ret != sizeof(st) || st.version != DHT_STATUS_VERSION)
+        {
+            perror("Read failed");
+        }
+        else if (!(st.flags & DHT_STATUS_VALID))
+        {
+            printf("Waiting for the first measurement...\n");
+        }
+        else
+        {
+            printf("Humidity: %d.%d %%, Temperature: %s%d.%d C (age %u ms", st.humidity / 1000,
+                   st.humidity % 1000 / 100, st.temperature < 0 ? "-" : "",
+                   abs(st.temperature) / 1000, abs(st.temperature) % 1000 / 100, st.age_ms);
+            if (st.failures)
+                printf(", %u failed since: %s", st.failures, strerror(-st.last_err));
+            printf(")\n");
+        }
+        sleep(2); // 两次采样至少间隔 2 秒
+    }
+
+    close(fd);
+    return 0;
+}
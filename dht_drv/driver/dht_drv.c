@@ -0,0 +1,1665 @@
+#include <linux/cdev.h>
+#include <linux/completion.h>
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/device.h>
+#include <linux/fs.h>
+#include <linux/gpio/consumer.h> // 新版GPIO API
+#include <linux/hrtimer.h>
+#include <linux/idr.h>
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/of.h>
+#include <linux/of_device.h>
+#include <linux/property.h>
+#include <linux/platform_device.h>
+#include <linux/poll.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/timekeeping.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+#if IS_ENABLED(CONFIG_IIO_TRIGGERED_BUFFER)
+#include <linux/iio/iio.h> // IIO 后端 (内核未开启 IIO 时自动去掉)
+#include <linux/iio/buffer.h>
+#include <linux/iio/trigger.h>
+#include <linux/iio/trigger_consumer.h>
+#include <linux/iio/triggered_buffer.h>
+#endif
+
+/*
+ * DHT 系列温湿度传感器统一驱动 (DHT11 / DHT22 / AM2301 / AM2302)
+ *
+ * 各型号的单总线协议相同，只有起始信号长度、重试策略和数据格式不同，
+ * 这些差异放在 struct dht_profile 中，由设备树 compatible 对应的 of_device_id .data
+ * (或按名字匹配时 platform_device_id 的 driver_data) 选择；
+ * 采集状态机、解码、缓存和统计只有这一份
+ */
+
+#define DRIVER_NAME "dht-sensor" // 路径节点/sys/devices/platform/dht-sensor
+#define DEVICE_NAME "dht"        // 路径节点/dev/dht-N
+#define CLASS_NAME "dht"         // 路径节点/sys/class/dht
+#define DHT_MAX_DEVICES 8        // 最多支持的传感器数量，每个占两个次设备号 (dht-N 和旧驱动的兼容节点)
+#define DHT_MIN_INTERVAL_MS 2000 // 两次采集的最小间隔
+
+// 边沿中断解码
+#define DHT_MAX_EDGES 96           // 一帧约 84 个边沿，留出毛刺余量
+#define DHT_FRAME_EDGES 84         // 响应 3 个 + 40 位各 2 个 + 结束 1 个
+#define DHT_FRAME_TIMEOUT_MS 20    // 一帧最长约 5ms
+#define DHT_BIT_THRESHOLD_NS 50000 // 高电平 26~28us 为 0，70us 为 1
+#define DHT_PREAMBLE_MIN_NS 50000  // 前导高电平标称 80us，超出这个范围不用来校准阈值
+#define DHT_PREAMBLE_MAX_NS 120000
+
+// 调试统计
+#define DHT_PULSE_BUCKET_NS 4000 // 高电平脉宽直方图每格 4us
+#define DHT_PULSE_BUCKETS 33     // 0~128us，最后一格为溢出
+#define DHT_IRQOFF_BUCKETS 16    // 关中断时长直方图按 2 的幂分格: <1us, 1~2us, ... >=16ms
+
+// 解码方式
+#define DHT_DECODE_POLL 0 // 关中断忙等采样 (旧方式)
+#define DHT_DECODE_IRQ 1  // 边沿中断记录时间戳，帧结束后按脉宽解码，全程不关中断
+
+static int decode_mode = DHT_DECODE_IRQ;
+module_param(decode_mode, int, 0644);
+MODULE_PARM_DESC(decode_mode, "0 = busy-wait with irqs off, 1 = GPIO edge irq timestamps (default)");
+
+// 按每帧前导脉冲的宽度校准 0/1 阈值，关闭时使用固定的 DHT_BIT_THRESHOLD_NS
+static bool adaptive_threshold = true;
+module_param(adaptive_threshold, bool, 0644);
+MODULE_PARM_DESC(adaptive_threshold, "Derive the 0/1 threshold from each frame's 80us preamble (default Y)");
+
+// 后台周期采集: 非 0 时按该周期 (不小于 DHT_MIN_INTERVAL_MS) 自动采集，read() 直接返回最新缓存
+// 有多个传感器时，它们在一个周期内轮流、均匀错开地采集
+static unsigned int period_ms;
+module_param(period_ms, uint, 0444);
+MODULE_PARM_DESC(period_ms, "Background acquisition period in ms (0 = acquire on read, min 2000)");
+
+// 过渡用: 原来由 dht22_drv 驱动的板子，设备树节点还是 "my,dht11"，置 1 时这些节点按 DHT22 解码
+static bool legacy_dht22;
+module_param(legacy_dht22, bool, 0444);
+MODULE_PARM_DESC(legacy_dht22, "Decode \"my,dht11\" nodes as DHT22 like the old dht22_drv");
+
+/* 旧驱动 (dht11_drv / dht22_drv) 的设备类和节点名，过渡期间作为兼容节点保留 */
+enum dht_legacy
+{
+    DHT_LEGACY_DHT11, // /sys/class/dht11，/dev/dht11-N
+    DHT_LEGACY_DHT22, // /sys/class/dht22，/dev/dht22-N
+    DHT_LEGACY_NR,
+};
+
+static const char *const dht_legacy_names[DHT_LEGACY_NR] = {"dht11", "dht22"};
+
+/* 型号相关的时序和数据格式 */
+struct dht_profile
+{
+    const char *name;            // 型号名，/sys/class/dht/dht-N/model (AM2301/AM2302 与 DHT22 共用)
+    unsigned int start_ms;       // 起始信号拉低时间
+    unsigned int release_us;     // 忙等方式拉高数据线后等待传感器响应的时间
+    unsigned int timeout_us;     // 忙等方式每个电平的超时
+    unsigned int max_retry;      // 一次采集最多尝试的次数
+    unsigned int retry_delay_ms; // 失败后到下一次起始信号的间隔
+    unsigned int legacy_len;     // 兼容旧驱动的定长读取的长度
+    enum dht_legacy legacy_node; // 原来由哪个旧驱动负责，决定兼容节点的类和名字
+    // 原始 4 字节 -> 兼容读取的格式
+    void (*legacy)(const u8 *raw, u8 *out);
+    // 原始 4 字节 -> 0.001 %RH / 0.001 °C
+    void (*convert)(const u8 *raw, s32 *humidity, s32 *temperature);
+};
+
+/* --- ioctl 接口 (用户态需保持一致) ---
+ * read() 的输出格式按打开的文件分别设置，默认为兼容旧驱动的定长读取
+ */
+#define DHT_IOC_MAGIC 'H'
+#define DHT_IOC_SET_FORMAT _IOW(DHT_IOC_MAGIC, 1, __u32)
+#define DHT_IOC_GET_FORMAT _IOR(DHT_IOC_MAGIC, 2, __u32)
+
+#define DHT_FMT_LEGACY 0 // DHT11 为 [湿度, 温度]，其它为原始 4 字节 (profile->legacy_len)
+#define DHT_FMT_RECORD 1 // struct dht_record
+#define DHT_FMT_STATUS 2 // struct dht_status，不阻塞
+
+/* 带时间戳的读取记录，DHT_FMT_RECORD 格式 (用户态需保持一致) */
+struct dht_record
+{
+    __u64 timestamp_ns; // 采集时刻 (CLOCK_BOOTTIME)
+    __u32 age_ms;       // 读取时距离采集已经过去的时间
+    __u8 data[4];       // 同兼容读取: DHT11 为 [湿度, 温度, 0, 0]，其它为原始 4 字节
+};
+
+/* 带版本的状态记录，DHT_FMT_STATUS 格式 (用户态需保持一致)
+ * 这种读取从不阻塞、也不返回采集错误: 缓存过期时在后台启动采集，立即返回最近一次成功的测量，
+ * 数据新旧由 age_ms 和 failures 判断；以后增加字段时只在末尾追加并增大 version
+ */
+#define DHT_STATUS_VERSION 1
+#define DHT_STATUS_VALID (1 << 0) // humidity/temperature 有效 (至少成功测量过一次)
+#define DHT_STATUS_BUSY (1 << 1)  // 正在采集，新数据到达时 poll 报告可读
+
+struct dht_status
+{
+    __u16 version;      // DHT_STATUS_VERSION
+    __u16 size;         // sizeof(struct dht_status)
+    __u32 flags;        // DHT_STATUS_*
+    __u64 timestamp_ns; // 最近一次成功测量的时刻 (CLOCK_BOOTTIME)
+    __u32 age_ms;       // 读取时距离该测量已经过去的时间
+    __u32 failures;     // 该测量之后连续失败的采集次数
+    __s32 humidity;     // 0.001 %RH
+    __s32 temperature;  // 0.001 °C，可以为负
+    __s32 last_err;     // 最近一次采集的结果: 0、-ETIMEDOUT、-EBADMSG ...
+    __u32 seq;          // 成功测量的序号，每次新测量加 1
+};
+
+/* 异步采集状态机
+ * 起始信号和重试间隔都由 hrtimer 计时，期间不占 CPU；定时器到期后在工作队列中切换状态
+ */
+enum dht_state
+{
+    DHT_IDLE,    // 空闲
+    DHT_WAIT,    // 等待其它传感器的采集结束 (同一时刻只允许一个传感器采集)
+    DHT_START,   // 正在发送起始信号 (数据线拉低)
+    DHT_RECV,    // 正在接收一帧 (边沿中断方式)
+    DHT_BACKOFF, // 本次失败，等待重试
+};
+
+/* 超时发生在哪个阶段，按超时前收到的边沿数判断 */
+enum dht_phase
+{
+    DHT_PHASE_RESPONSE, // 释放总线后传感器没有拉低
+    DHT_PHASE_PREAMBLE, // 80us 响应/前导脉冲不完整
+    DHT_PHASE_DATA,     // 40 位数据不完整
+    DHT_PHASE_NR,
+};
+
+static const char *const dht_phase_names[DHT_PHASE_NR] = {"response", "preamble", "data"};
+
+struct dht_dev;
+
+/* 每个打开的文件各自的状态 */
+struct dht_file
+{
+    struct dht_dev *dht;
+    u32 format;     // read() 输出格式 DHT_FMT_*
+    bool by_length; // 从兼容节点打开、还没有设置过格式: 像旧驱动一样按 read() 长度选择格式
+    u32 seq;        // 本文件已经读到的测量 (dht->seq)
+    u32 err_seq;    // 本文件已经报告过的失败 (dht->err_seq)
+};
+
+struct dht_dev
+{
+    dev_t dev_id;                      // 存放设备号 (主设备号+次设备号)
+    int minor;                         // 次设备号，也是 /dev/dht-N 中的 N
+    struct cdev cdev;                  // 内核字符设备的核心结构体
+    struct device device;              // /dev/dht-N，引用计数管理本结构，仍然打开的文件关闭之前不会释放
+    struct cdev legacy_cdev;           // 旧驱动的兼容节点 /dev/dht11-N 或 /dev/dht22-N
+    int legacy_id;                     // 兼容节点的编号 N，< 0 表示没有创建
+    const struct dht_profile *profile; // 型号相关的时序和数据格式
+    struct list_head node;             // 挂在 dht_list 上，后台采集按这个顺序轮流
+    struct list_head slot_node;        // 等待采集时间片时挂在 dht_slot_waiters 上
+    struct gpio_desc *gpio;            // 现代 GPIO 描述符 (替代旧的 int gpio_num)
+    struct mutex lock;                 // 互斥锁，保护缓存和状态机，不在等待传感器期间持有
+    unsigned long last_read_time;      // 上次读取时间
+    u8 raw[4];                         // 最近一次成功测量的原始 4 字节 (不含校验)
+    u32 fail_streak;                   // 最近一次成功测量之后连续失败的采集次数
+    u64 cached_ns;                     // 缓存数据的采集时刻 (CLOCK_BOOTTIME)
+    bool data_valid;                   // 缓存数据是否有效
+
+    // --- 异步采集 ---
+    enum dht_state state;             // 当前状态，受 lock 保护
+    int retry;                        // 本次采集已经失败的次数
+    int last_err;                     // 最近一次采集的结果
+    bool stopping;                    // 设备还没注册完或已经移除: 不再启动新的状态，打开的文件得到 -ENODEV
+    ktime_t deadline;                 // 当前状态的到期时间
+    struct hrtimer timer;             // 状态到期定时器
+    struct work_struct work;          // 状态切换在这里执行 (可以睡眠)
+    struct completion done;           // 一次采集 (含重试) 结束，等待的读者在这里睡眠
+    wait_queue_head_t poll_wq;        // 一次采集结束时唤醒 poll/epoll
+    struct delayed_work expire_dwork; // 缓存过期时唤醒 poll/epoll，由它们启动下一次采集
+    u32 seq;                          // 成功采集的次数
+    u32 err_seq;                      // 失败采集的次数 (重试全部失败才算一次)
+
+    // --- 边沿中断解码 ---
+    int irq;                      // 数据线对应的中断号，<= 0 时只能用忙等方式
+    bool irq_enabled;             // 接收期间打开了中断 (中断在 probe 中申请，平时关闭)
+    u64 release_ns;               // 释放总线的时刻，之前执行的中断处理不记录；0 = 不在接收
+    bool frame_complete;          // 已收齐一帧的边沿
+    unsigned int nedges;          // 已记录的边沿数
+    u64 edge_ns[DHT_MAX_EDGES];   // 每个边沿的时间 (ns)
+    u8 edge_level[DHT_MAX_EDGES]; // 边沿之后的电平
+
+    // --- 调试信息 (debugfs) ---
+    struct dentry *debugfs;              // /sys/kernel/debug/dht/dht-N
+    u32 threshold_ns;                    // 最近一帧使用的 0/1 阈值
+    u32 preamble_ns;                     // 最近一帧实测的前导高电平宽度，0 = 没有测到
+    u32 nr_fixed_threshold;              // 前导脉冲不可用、退回固定阈值的帧数
+    u32 nr_captures;                     // 采集次数 (一次采集含若干次尝试)
+    u32 nr_attempts;                     // 尝试次数 (每次起始信号算一次)
+    u32 nr_retries;                      // 重试次数
+    u32 nr_failures;                     // 重试全部失败的采集次数
+    u32 nr_timeouts[DHT_PHASE_NR];       // 按阶段统计的超时 (-ETIMEDOUT)
+    u32 nr_checksum_errors;              // 校验和错误 (-EBADMSG)
+    u32 nr_cache_hits;                   // read() 直接返回缓存的次数
+    u64 irqoff_ns;                       // 本次尝试关中断的总时长
+    u32 pulse_hist[DHT_PULSE_BUCKETS];   // 实测高电平脉宽直方图
+    u32 irqoff_hist[DHT_IRQOFF_BUCKETS]; // 每次尝试关中断总时长的直方图 (us)
+
+#if IS_ENABLED(CONFIG_IIO_TRIGGERED_BUFFER)
+    // --- IIO 后端 ---
+    struct iio_dev *indio_dev;
+    struct iio_trigger *trig; // 新测量触发器，每次成功采集触发一次
+#endif
+};
+
+/* 所有传感器共用的设备号区间和类 */
+static dev_t dht_devt;
+static struct class *dht_class;
+static DEFINE_IDA(dht_ida);
+static struct dentry *dht_debugfs_root;
+
+/* 旧驱动的设备类和编号: 兼容节点的次设备号为 DHT_MAX_DEVICES + minor，编号 N 在各自的类中分配 */
+static struct class *dht_legacy_class[DHT_LEGACY_NR];
+static struct ida dht_legacy_ida[DHT_LEGACY_NR];
+
+/* 采集时间片: 起始信号和接收一帧对时序敏感 (忙等方式还会关中断)，
+ * 同一时刻只允许一个传感器处于这两个阶段，其余的按申请顺序排队
+ */
+static DEFINE_SPINLOCK(dht_slot_lock);
+static struct dht_dev *dht_slot_owner;
+static LIST_HEAD(dht_slot_waiters);
+
+/* 后台周期采集: 一个工作轮流启动各个传感器，间隔为 周期/传感器数 */
+static DEFINE_MUTEX(dht_list_lock);
+static LIST_HEAD(dht_list);
+static unsigned int dht_count;
+static void dht_poll_work(struct work_struct *work);
+static DECLARE_DELAYED_WORK(dht_poll_dwork, dht_poll_work);
+
+static void dht_iio_push(struct dht_dev *dht);
+
+/* 申请采集时间片，拿到时返回 true；否则排队，轮到时由释放者排队本设备的工作 */
+static bool dht_slot_get(struct dht_dev *dht)
+{
+    bool granted;
+
+    spin_lock(&dht_slot_lock);
+    if (!dht_slot_owner)
+        dht_slot_owner = dht;
+    granted = dht_slot_owner == dht;
+    if (!granted && list_empty(&dht->slot_node))
+        list_add_tail(&dht->slot_node, &dht_slot_waiters);
+    spin_unlock(&dht_slot_lock);
+
+    return granted;
+}
+
+/* 释放时间片 (或退出排队)，持有者释放时直接交给下一个等待者
+ * 在锁内排队下一个等待者的工作，保证它移除时 cancel_work_sync 能等到
+ */
+static void dht_slot_put(struct dht_dev *dht)
+{
+    struct dht_dev *next;
+
+    spin_lock(&dht_slot_lock);
+    list_del_init(&dht->slot_node);
+    if (dht_slot_owner == dht)
+    {
+        next = list_first_entry_or_null(&dht_slot_waiters, struct dht_dev, slot_node);
+        if (next)
+        {
+            list_del_init(&next->slot_node);
+            queue_work(system_highpri_wq, &next->work);
+        }
+        dht_slot_owner = next;
+    }
+    spin_unlock(&dht_slot_lock);
+}
+
+/* 进入 state，ms 毫秒后到期，到期时由工作队列继续处理 */
+static void dht_arm(struct dht_dev *dht, enum dht_state state, unsigned int ms)
+{
+    dht->state = state;
+    dht->deadline = ktime_add_ms(ktime_get(), ms);
+    hrtimer_start(&dht->timer, ms_to_ktime(ms), HRTIMER_MODE_REL);
+}
+
+/* 发送起始信号: 拉低数据线，由定时器计时，不占 CPU
+ * 其它传感器正在采集时先进入 WAIT，轮到本设备时工作会再次调用这里
+ */
+static void dht_start(struct dht_dev *dht)
+{
+    if (!dht_slot_get(dht))
+    {
+        dht->state = DHT_WAIT;
+        dht->deadline = 0;
+        return;
+    }
+
+    gpiod_direction_output(dht->gpio, 0);
+    dht_arm(dht, DHT_START, dht->profile->start_ms);
+}
+
+/* 按高电平脉宽解码: 只取最后 40 个完整的高电平脉冲，
+ * 之前的是 80us 响应脉冲或释放总线时的边沿，漏掉开头的边沿也不影响结果
+ *
+ * 自适应阈值: 传感器 0/1 的高电平宽度 (26~28us / 70us) 和前导高电平 (80us) 由同一个时钟产生，
+ * GPIO 读取延迟、线长等使脉宽整体偏移或伸缩时，前导脉冲也按同样的比例变化，
+ * 所以按每帧实测的前导脉宽的 5/8 (标称 50us) 作为阈值；前导脉冲缺失或明显不合理时退回固定阈值
+ */
+static int dht_decode_edges(struct dht_dev *dht, unsigned char *data)
+{
+    u32 width[DHT_MAX_EDGES / 2];
+    unsigned int nedges = dht->nedges;
+    unsigned int i, n = 0;
+    u32 threshold = DHT_BIT_THRESHOLD_NS;
+    u32 preamble = 0;
+
+    for (i = 0; i + 1 < nedges; i++)
+    {
+        if (dht->edge_level[i] && !dht->edge_level[i + 1])
+        {
+            width[n] = (u32)(dht->edge_ns[i + 1] - dht->edge_ns[i]);
+            dht->pulse_hist[min_t(u32, width[n] / DHT_PULSE_BUCKET_NS,
+                                  DHT_PULSE_BUCKETS - 1)]++;
+            n++;
+        }
+    }
+
+    // 边沿不够说明帧没有收完整，按超时处理
+    if (n < 40)
+        return -ETIMEDOUT;
+
+    if (n > 40)
+        preamble = width[n - 41];
+    if (READ_ONCE(adaptive_threshold) && preamble >= DHT_PREAMBLE_MIN_NS &&
+        preamble <= DHT_PREAMBLE_MAX_NS)
+        threshold = preamble * 5 / 8;
+    else if (READ_ONCE(adaptive_threshold))
+        dht->nr_fixed_threshold++;
+
+    dht->preamble_ns = preamble;
+    dht->threshold_ns = threshold;
+
+    for (i = 0; i < 40; i++)
+    {
+        if (width[n - 40 + i] > threshold)
+            data[i / 8] |= 1 << (7 - i % 8);
+    }
+
+    return 0;
+}
+
+/* 忙等到数据线变为 level，并像边沿中断一样记录这个边沿，超时返回 -ETIMEDOUT */
+static int dht_poll_edge(struct dht_dev *dht, int level)
+{
+    int time_cnt = 0;
+
+    while (gpiod_get_value(dht->gpio) != level)
+    {
+        udelay(1);
+        if (++time_cnt > dht->profile->timeout_us)
+            return -ETIMEDOUT;
+    }
+
+    dht->edge_ns[dht->nedges] = ktime_get_ns();
+    dht->edge_level[dht->nedges] = level;
+    dht->nedges++;
+    return 0;
+}
+
+/* 记录本次尝试关中断的总时长 */
+static void dht_account_irqoff(struct dht_dev *dht)
+{
+    u32 us = div_u64(dht->irqoff_ns, NSEC_PER_USEC);
+
+    dht->irqoff_hist[min_t(u32, fls(us), DHT_IRQOFF_BUCKETS - 1)]++;
+}
+
+/* 忙等方式读取一帧 (旧方式)
+ * 在关中断的情况下用 udelay(1) 轮询电平并记录每个边沿的时间，之后和边沿中断方式一样按脉宽解码
+ * (旧版本在上升沿后固定 40us 采样一次，GPIO 读取延迟和线长使脉宽偏移时容易误判)
+ */
+static int dht_capture_poll(struct dht_dev *dht, unsigned char *data)
+{
+    int i;
+    unsigned long flags;
+    int ret;
+    u64 t0;
+
+    dht->nedges = 0;
+
+    gpiod_set_value(dht->gpio, 1);
+    udelay(dht->profile->release_us);
+
+    gpiod_direction_input(dht->gpio);
+
+    t0 = ktime_get_ns();
+    local_irq_save(flags);
+
+    // 响应: 拉低 80us、拉高 80us (前导脉冲)
+    ret = dht_poll_edge(dht, 0);
+    if (!ret)
+        ret = dht_poll_edge(dht, 1);
+    if (!ret)
+        ret = dht_poll_edge(dht, 0);
+
+    // 40 位数据: 每位 50us 低电平之后跟一个高电平，高电平的宽度决定 0/1
+    for (i = 0; i < 40 && !ret; i++)
+    {
+        ret = dht_poll_edge(dht, 1);
+        if (!ret)
+            ret = dht_poll_edge(dht, 0);
+    }
+
+    local_irq_restore(flags);
+    dht->irqoff_ns = ktime_get_ns() - t0;
+    dht_account_irqoff(dht);
+
+    if (ret)
+        return ret;
+    return dht_decode_edges(dht, data);
+}
+
+/* 数据线边沿中断 (硬中断上下文): 只记录时间和电平，解码放到帧结束之后
+ * 处理函数本身的执行时间计入关中断时长 (不含中断进入/退出的开销)
+ */
+static irqreturn_t dht_edge_irq(int irq, void *dev_id)
+{
+    struct dht_dev *dht = dev_id;
+    unsigned int n = dht->nedges;
+    u64 now = ktime_get_ns();
+    u64 release = READ_ONCE(dht->release_ns);
+    int level;
+
+    // 打开中断时会补发发送起始信号期间挂起的边沿，在释放总线之前执行的一律忽略
+    if (!release || now < release)
+        return IRQ_HANDLED;
+
+    // 补发可能经 tasklet 延后到释放总线之后才执行，这时记录的是当前电平；
+    // 与上一个记录的电平相同说明没有新的跳变 (补发的，或者真实边沿已经由补发记录过)，不算一个边沿，
+    // 这样记录的边沿数就是实际的电平跳变数，收齐整帧的判断不会提前
+    level = gpiod_get_value(dht->gpio);
+    if (n < DHT_MAX_EDGES && !(n && level == dht->edge_level[n - 1]))
+    {
+        dht->edge_ns[n] = now;
+        dht->edge_level[n] = level;
+        dht->nedges = ++n;
+        if (n == DHT_FRAME_EDGES)
+        {
+            WRITE_ONCE(dht->frame_complete, true);
+            queue_work(system_highpri_wq, &dht->work);
+        }
+    }
+
+    dht->irqoff_ns += ktime_get_ns() - now;
+    return IRQ_HANDLED;
+}
+
+/* 边沿中断方式: 打开中断之后再释放总线，传感器的第一个响应边沿不会漏掉
+ * 数据线按开漏方式申请，中断在 probe 中申请一次 (IRQF_NO_AUTOEN)，占用为中断时仍然可以拉低发送起始信号
+ * 释放时刻在数据线拉高之后记录，传感器 20us 之后才响应，之前执行的处理函数 (起始信号边沿的补发、
+ * 释放总线的上升沿) 都被忽略；释放总线的上升沿即使被记录，解码只取最后 40 个高电平脉冲，也不受影响
+ */
+static void dht_capture_begin(struct dht_dev *dht)
+{
+    dht->nedges = 0;
+    dht->frame_complete = false;
+    dht->irqoff_ns = 0;
+
+    enable_irq(dht->irq);
+    dht->irq_enabled = true;
+
+    // 释放总线，由上拉电阻拉高，传感器 20~40us 后开始响应
+    gpiod_direction_input(dht->gpio);
+    WRITE_ONCE(dht->release_ns, ktime_get_ns());
+
+    // 收齐整帧的边沿时中断处理函数会提前排队工作；开头漏掉一个边沿则等到超时，解码时照样可用
+    dht_arm(dht, DHT_RECV, DHT_FRAME_TIMEOUT_MS);
+}
+
+/* 关闭中断 (等待正在执行的处理函数返回)，之后可以安全地读取边沿记录 */
+static void dht_capture_stop(struct dht_dev *dht)
+{
+    if (!dht->irq_enabled)
+        return;
+
+    disable_irq(dht->irq);
+    dht->irq_enabled = false;
+    WRITE_ONCE(dht->release_ns, 0);
+}
+
+static int dht_capture_end(struct dht_dev *dht, unsigned char *data)
+{
+    dht_capture_stop(dht);
+    dht_account_irqoff(dht);
+
+    return dht_decode_edges(dht, data);
+}
+
+/* 超时之前收到的传感器边沿: 0 个为没有响应，不到 3 个 (低、高、低) 为前导脉冲不完整，否则为数据不完整
+ * 边沿中断方式记录的第一个边沿可能是释放总线时的上升沿，不算传感器的
+ */
+static enum dht_phase dht_timeout_phase(struct dht_dev *dht)
+{
+    unsigned int nedges = dht->nedges;
+
+    if (nedges && dht->edge_level[0])
+        nedges--;
+    if (nedges == 0)
+        return DHT_PHASE_RESPONSE;
+    if (nedges < 3)
+        return DHT_PHASE_PREAMBLE;
+    return DHT_PHASE_DATA;
+}
+
+/* 一次尝试结束
+ * 数据格式: 4 字节数据 (含义由型号决定) + 8bit校验
+ * 成功时更新缓存；失败且还有重试次数时进入 BACKOFF，否则结束本次采集并唤醒读者
+ * 无论结果如何都释放采集时间片，重试间隔期间其它传感器可以采集
+ * 失败原因: -ETIMEDOUT 帧不完整 (按阶段统计)，-EBADMSG 校验和错误
+ */
+static void dht_finish_attempt(struct dht_dev *dht, int ret, const unsigned char *data)
+{
+    // 保持总线空闲 (高电平)，等待下一次起始信号
+    gpiod_direction_output(dht->gpio, 1);
+    dht_slot_put(dht);
+
+    if (!ret && data[4] != ((data[0] + data[1] + data[2] + data[3]) & 0xFF))
+        ret = -EBADMSG;
+
+    dht->nr_attempts++;
+    if (ret == -ETIMEDOUT)
+        dht->nr_timeouts[dht_timeout_phase(dht)]++;
+    else if (ret == -EBADMSG)
+        dht->nr_checksum_errors++;
+
+    if (!ret)
+    {
+        memcpy(dht->raw, data, 4);
+        dht->fail_streak = 0;
+        dht->last_read_time = jiffies;
+        dht->cached_ns = ktime_get_boottime_ns();
+        dht->data_valid = true;
+        dht->seq++;
+        dht_iio_push(dht);
+    }
+    else if (++dht->retry < dht->profile->max_retry)
+    {
+        dht->nr_retries++;
+        dht_arm(dht, DHT_BACKOFF, dht->profile->retry_delay_ms);
+        return;
+    }
+
+    if (ret)
+    {
+        dht->err_seq++;
+        dht->fail_streak++;
+        dht->nr_failures++;
+    }
+    dht->last_err = ret;
+    dht->state = DHT_IDLE;
+    complete_all(&dht->done);
+    wake_up_interruptible(&dht->poll_wq);
+}
+
+/* 状态切换 (工作队列上下文) */
+static void dht_work(struct work_struct *work)
+{
+    struct dht_dev *dht = container_of(work, struct dht_dev, work);
+    unsigned char data[5] = {0};
+    int ret;
+
+    mutex_lock(&dht->lock);
+
+    if (dht->stopping || dht->state == DHT_IDLE)
+        goto out;
+
+    // 定时器和边沿中断都会排队本工作，还没到期的 (已经处理过的) 唤醒直接忽略
+    if (ktime_before(ktime_get(), dht->deadline) &&
+        !(dht->state == DHT_RECV && READ_ONCE(dht->frame_complete)))
+        goto out;
+
+    switch (dht->state)
+    {
+    case DHT_WAIT:
+    case DHT_BACKOFF:
+        dht_start(dht);
+        break;
+
+    case DHT_START:
+        if (READ_ONCE(decode_mode) == DHT_DECODE_IRQ && dht->irq > 0)
+        {
+            dht_capture_begin(dht);
+            break;
+        }
+        // 忙等方式在这里直接收完一帧
+        ret = dht_capture_poll(dht, data);
+        dht_finish_attempt(dht, ret, data);
+        break;
+
+    case DHT_RECV:
+        hrtimer_cancel(&dht->timer);
+        ret = dht_capture_end(dht, data);
+        dht_finish_attempt(dht, ret, data);
+        break;
+
+    default:
+        break;
+    }
+
+out:
+    mutex_unlock(&dht->lock);
+}
+
+static enum hrtimer_restart dht_timer(struct hrtimer *timer)
+{
+    struct dht_dev *dht = container_of(timer, struct dht_dev, timer);
+
+    queue_work(system_highpri_wq, &dht->work);
+    return HRTIMER_NORESTART;
+}
+
+/* 启动一次采集，已有采集在进行时什么都不做，调用者需持有 lock */
+static void dht_kick(struct dht_dev *dht)
+{
+    if (dht->state != DHT_IDLE || dht->stopping)
+        return;
+
+    dht->retry = 0;
+    dht->nr_captures++;
+    reinit_completion(&dht->done);
+    dht_start(dht);
+}
+
+/* 缓存是否可以直接返回，调用者需持有 lock
+ * 后台采集模式下缓存总是最新的；否则只在最小采样间隔内有效
+ */
+static bool dht_cache_fresh(struct dht_dev *dht)
+{
+    if (!dht->data_valid)
+        return false;
+    if (period_ms)
+        return true;
+    return time_before(jiffies, dht->last_read_time + msecs_to_jiffies(DHT_MIN_INTERVAL_MS));
+}
+
+/* 按需采集模式下缓存过期: 唤醒 poll/epoll 重新检查，还在等待的由 dht_poll 启动采集 */
+static void dht_expire_work(struct work_struct *work)
+{
+    struct dht_dev *dht = container_of(to_delayed_work(work), struct dht_dev, expire_dwork);
+
+    wake_up_interruptible(&dht->poll_wq);
+}
+
+/* 后台周期采集: 每次启动队首的传感器并把它移到队尾，只负责启动，采集本身仍由状态机异步完成
+ * 每个传感器一个周期采集一次，相邻两个传感器之间错开 周期/传感器数
+ */
+static void dht_poll_work(struct work_struct *work)
+{
+    struct dht_dev *dht;
+    unsigned int period = max_t(unsigned int, period_ms, DHT_MIN_INTERVAL_MS);
+
+    mutex_lock(&dht_list_lock);
+    dht = list_first_entry_or_null(&dht_list, struct dht_dev, node);
+    if (dht)
+    {
+        list_move_tail(&dht->node, &dht_list);
+
+        mutex_lock(&dht->lock);
+        dht_kick(dht);
+        mutex_unlock(&dht->lock);
+
+        schedule_delayed_work(&dht_poll_dwork, msecs_to_jiffies(period / dht_count));
+    }
+    mutex_unlock(&dht_list_lock);
+}
+
+/* DHT11: 整数字节 + 小数字节 (0.1)，部分版本用温度小数字节的最高位表示负温度 */
+static void dht11_convert(const u8 *raw, s32 *humidity, s32 *temperature)
+{
+    *humidity = raw[0] * 1000 + raw[1] * 100;
+    *temperature = raw[2] * 1000 + (raw[3] & 0x7F) * 100;
+    if (raw[3] & 0x80)
+        *temperature = -*temperature;
+}
+
+/* DHT11 兼容读取: [湿度, 温度] 整数部分 */
+static void dht11_legacy(const u8 *raw, u8 *out)
+{
+    out[0] = raw[0];
+    out[1] = raw[2];
+}
+
+/* DHT22/AM230x: 16 位湿度、16 位温度，单位 0.1，温度最高位为符号位 */
+static void dht22_convert(const u8 *raw, s32 *humidity, s32 *temperature)
+{
+    *humidity = ((raw[0] << 8) | raw[1]) * 100;
+    *temperature = (((raw[2] & 0x7F) << 8) | raw[3]) * 100;
+    if (raw[2] & 0x80)
+        *temperature = -*temperature;
+}
+
+/* DHT22/AM230x 兼容读取: 原始 4 字节 */
+static void dht22_legacy(const u8 *raw, u8 *out)
+{
+    memcpy(out, raw, 4);
+}
+
+/* 各型号的参数，起始信号长度和重试策略沿用原 dht11_drv / dht22_drv 中验证过的值 */
+static const struct dht_profile dht11_profile = {
+    .name = "dht11",
+    .start_ms = 20, // 手册要求至少 18ms
+    .release_us = 30,
+    .timeout_us = 150,
+    .max_retry = 3,
+    .retry_delay_ms = 50,
+    .legacy_len = 2,
+    .legacy_node = DHT_LEGACY_DHT11,
+    .legacy = dht11_legacy,
+    .convert = dht11_convert,
+};
+
+static const struct dht_profile dht22_profile = {
+    .name = "dht22",
+    .start_ms = 2, // 手册要求至少 1ms
+    .release_us = 40,
+    .timeout_us = 200,
+    .max_retry = 5,
+    .retry_delay_ms = 100,
+    .legacy_len = 4,
+    .legacy_node = DHT_LEGACY_DHT22,
+    .legacy = dht22_legacy,
+    .convert = dht22_convert,
+};
+
+#if IS_ENABLED(CONFIG_IIO_TRIGGERED_BUFFER)
+/* --- IIO 后端 ---
+ * 湿度 (milli %RH)、温度 (milli °C) 两个 processed 通道，单位与状态记录相同；
+ * 单次读取和字符设备 read() 一样走缓存，缓存过期时启动一次采集并等待
+ */
+enum dht_scan_index
+{
+    DHT_SCAN_HUMIDITY,
+    DHT_SCAN_TEMP,
+    DHT_SCAN_TIMESTAMP,
+};
+
+#define DHT_IIO_CHAN(_type, _index)                                                                \
+    {                                                                                              \
+        .type = _type, .info_mask_separate = BIT(IIO_CHAN_INFO_PROCESSED), .scan_index = _index,   \
+        .scan_type = {                                                                             \
+            .sign = 's', .realbits = 32, .storagebits = 32, .endianness = IIO_CPU,                 \
+        },                                                                                         \
+    }
+
+static const struct iio_chan_spec dht_iio_channels[] = {
+    DHT_IIO_CHAN(IIO_HUMIDITYRELATIVE, DHT_SCAN_HUMIDITY),
+    DHT_IIO_CHAN(IIO_TEMP, DHT_SCAN_TEMP),
+    IIO_CHAN_SOFT_TIMESTAMP(DHT_SCAN_TIMESTAMP),
+};
+
+// 一帧同时包含湿度和温度，用户只打开部分通道时由 IIO core 拆分
+static const unsigned long dht_iio_scan_masks[] = {GENMASK(DHT_SCAN_TEMP, 0), 0};
+
+static int dht_iio_read_raw(struct iio_dev *indio_dev, struct iio_chan_spec const *chan, int *val,
+                            int *val2, long mask)
+{
+    struct dht_dev *dht = *(struct dht_dev **)iio_priv(indio_dev);
+    s32 humidity, temperature;
+    int ret;
+
+    if (mask != IIO_CHAN_INFO_PROCESSED)
+        return -EINVAL;
+
+    // 缓冲采集也只读缓存、不直接访问数据线，所以不需要 claim direct mode
+    mutex_lock(&dht->lock);
+    if (dht_cache_fresh(dht))
+    {
+        dht->nr_cache_hits++;
+    }
+    else
+    {
+        dht_kick(dht);
+        mutex_unlock(&dht->lock);
+
+        ret = wait_for_completion_interruptible(&dht->done);
+        if (ret)
+            return -ERESTARTSYS;
+
+        mutex_lock(&dht->lock);
+        if (dht->last_err || !dht->data_valid)
+        {
+            ret = dht->last_err ? dht->last_err : -EIO;
+            mutex_unlock(&dht->lock);
+            return ret;
+        }
+    }
+    dht->profile->convert(dht->raw, &humidity, &temperature);
+    mutex_unlock(&dht->lock);
+
+    *val = chan->type == IIO_TEMP ? temperature : humidity;
+    return IIO_VAL_INT;
+}
+
+static const struct iio_info dht_iio_info = {
+    .read_raw = dht_iio_read_raw,
+};
+
+/* 触发处理函数 (线程上下文)，推送缓存中最近一次成功的测量，时间戳为测量时刻
+ * 用自己的触发器时由 dht_finish_attempt 同步调用，调用者已持有 lock；
+ * 用其他触发器 (如 hrtimer trigger) 时按该触发器的节奏推送，缓存过期时在后台启动采集，不等待
+ */
+static irqreturn_t dht_iio_trigger_handler(int irq, void *p)
+{
+    struct iio_poll_func *pf = p;
+    struct iio_dev *indio_dev = pf->indio_dev;
+    struct dht_dev *dht = *(struct dht_dev **)iio_priv(indio_dev);
+    struct
+    {
+        s32 data[2];
+        s64 ts __aligned(8);
+    } scan = {};
+    bool own = iio_trigger_using_own(indio_dev);
+    bool valid;
+
+    if (!own)
+    {
+        mutex_lock(&dht->lock);
+        if (!dht_cache_fresh(dht))
+            dht_kick(dht);
+    }
+
+    valid = dht->data_valid;
+    if (valid)
+    {
+        dht->profile->convert(dht->raw, &scan.data[0], &scan.data[1]);
+        // 测量时刻是 CLOCK_BOOTTIME，换算到 IIO 当前选择的时钟
+        scan.ts = iio_get_time_ns(indio_dev) - (ktime_get_boottime_ns() - dht->cached_ns);
+    }
+
+    if (!own)
+        mutex_unlock(&dht->lock);
+
+    if (valid)
+        iio_push_to_buffers_with_timestamp(indio_dev, &scan, scan.ts);
+
+    iio_trigger_notify_done(indio_dev->trig);
+    return IRQ_HANDLED;
+}
+
+// 新测量触发器只给本设备使用: 触发时已经持有本设备的 lock，处理函数不能再去拿其它设备的锁
+static const struct iio_trigger_ops dht_iio_trigger_ops = {
+    .validate_device = iio_trigger_validate_own_device,
+};
+
+/* 成功采集后调用 (持有 lock)，buffer 未打开时什么都不做 */
+static void dht_iio_push(struct dht_dev *dht)
+{
+    if (!dht->indio_dev || !iio_buffer_enabled(dht->indio_dev))
+        return;
+
+    // 在当前线程中同步执行所有挂在该触发器上的处理函数
+    iio_trigger_poll_chained(dht->trig);
+}
+
+static int dht_iio_register(struct dht_dev *dht, struct device *dev)
+{
+    struct iio_dev *indio_dev;
+    int ret;
+
+    indio_dev = devm_iio_device_alloc(dev, sizeof(dht));
+    if (!indio_dev)
+        return -ENOMEM;
+    *(struct dht_dev **)iio_priv(indio_dev) = dht;
+
+    indio_dev->name = dht->profile->name;
+    indio_dev->info = &dht_iio_info;
+    indio_dev->modes = INDIO_DIRECT_MODE;
+    indio_dev->channels = dht_iio_channels;
+    indio_dev->num_channels = ARRAY_SIZE(dht_iio_channels);
+    indio_dev->available_scan_masks = dht_iio_scan_masks;
+
+    // 新测量触发器: 由采集状态机驱动，配合 period_ms 后台采集使用
+    dht->trig = devm_iio_trigger_alloc(dev, "%s-dev%d", indio_dev->name,
+                                       iio_device_id(indio_dev));
+    if (!dht->trig)
+        return -ENOMEM;
+    dht->trig->ops = &dht_iio_trigger_ops;
+    iio_trigger_set_drvdata(dht->trig, dht);
+    ret = devm_iio_trigger_register(dev, dht->trig);
+    if (ret)
+        return ret;
+    indio_dev->trig = iio_trigger_get(dht->trig);
+
+    // 时间戳取测量时刻，不需要在上半部记录触发时刻
+    ret = devm_iio_triggered_buffer_setup(dev, indio_dev, NULL, dht_iio_trigger_handler, NULL);
+    if (ret)
+        return ret;
+
+    ret = devm_iio_device_register(dev, indio_dev);
+    if (ret)
+        return ret;
+
+    dht->indio_dev = indio_dev;
+    return 0;
+}
+#else
+static inline void dht_iio_push(struct dht_dev *dht)
+{
+}
+
+static inline int dht_iio_register(struct dht_dev *dht, struct device *dev)
+{
+    return 0;
+}
+#endif
+
+/* 状态记录读取 (struct dht_status)，不阻塞 */
+static ssize_t dht_read_status(struct dht_file *mf, char __user *buf)
+{
+    struct dht_dev *dht = mf->dht;
+    struct dht_status st = {
+        .version = DHT_STATUS_VERSION,
+        .size = sizeof(st),
+    };
+
+    mutex_lock(&dht->lock);
+    if (dht->stopping)
+    {
+        mutex_unlock(&dht->lock);
+        return -ENODEV;
+    }
+
+    // 缓存过期时在后台采集 (失败的重试也在后台)，本次直接返回已有的测量
+    if (dht_cache_fresh(dht))
+        dht->nr_cache_hits++;
+    else
+        dht_kick(dht);
+
+    if (dht->data_valid)
+    {
+        st.flags |= DHT_STATUS_VALID;
+        st.timestamp_ns = dht->cached_ns;
+        dht->profile->convert(dht->raw, &st.humidity, &st.temperature);
+    }
+    if (dht->state != DHT_IDLE)
+        st.flags |= DHT_STATUS_BUSY;
+    st.failures = dht->fail_streak;
+    st.last_err = dht->last_err;
+    st.seq = dht->seq;
+
+    // 状态记录同时报告了测量和失败，poll 不再重复报告
+    mf->seq = dht->seq;
+    mf->err_seq = dht->err_seq;
+
+    mutex_unlock(&dht->lock);
+
+    if (st.flags & DHT_STATUS_VALID)
+        st.age_ms = div_u64(ktime_get_boottime_ns() - st.timestamp_ns, NSEC_PER_MSEC);
+
+    return copy_to_user(buf, &st, sizeof(st)) ? -EFAULT : sizeof(st);
+}
+
+/* 各输出格式一次 read() 返回的长度 */
+static size_t dht_format_size(struct dht_dev *dht, u32 format)
+{
+    switch (format)
+    {
+    case DHT_FMT_RECORD:
+        return sizeof(struct dht_record);
+    case DHT_FMT_STATUS:
+        return sizeof(struct dht_status);
+    default:
+        return dht->profile->legacy_len;
+    }
+}
+
+/* 兼容节点按 read() 长度选择格式，与 dht11_drv / dht22_drv 相同: 长度必须正好是某种格式的长度 */
+static int dht_length_format(struct dht_dev *dht, size_t count)
+{
+    if (count == sizeof(struct dht_status))
+        return DHT_FMT_STATUS;
+    if (count == sizeof(struct dht_record))
+        return DHT_FMT_RECORD;
+    if (count == dht->profile->legacy_len)
+        return DHT_FMT_LEGACY;
+    return -EINVAL;
+}
+
+/* 按本文件的输出格式 (DHT_IOC_SET_FORMAT) 返回一条记录，缓冲区小于该格式的长度时返回 -EINVAL
+ * 默认格式和旧驱动相同 (DHT11 为 [湿度, 温度]，其它为原始 4 字节)
+ * O_NONBLOCK: 缓存有效时直接返回；否则启动一次采集并返回 -EAGAIN，结果到达后 poll 报告可读
+ */
+static ssize_t dht_read(struct file *filp, char __user *buf, size_t count, loff_t *off)
+{
+    struct dht_record rec = {};
+    size_t len;
+    int ret;
+    bool fresh;
+    struct dht_file *mf = filp->private_data;
+    struct dht_dev *dht = mf->dht;
+    u32 format = READ_ONCE(mf->format);
+
+    if (READ_ONCE(mf->by_length))
+    {
+        ret = dht_length_format(dht, count);
+        if (ret < 0)
+            return ret;
+        format = ret;
+    }
+
+    len = dht_format_size(dht, format);
+    if (count < len)
+        return -EINVAL;
+    if (format == DHT_FMT_STATUS)
+        return dht_read_status(mf, buf);
+
+    mutex_lock(&dht->lock);
+    if (dht->stopping)
+    {
+        mutex_unlock(&dht->lock);
+        return -ENODEV;
+    }
+
+    fresh = dht_cache_fresh(dht);
+    if (fresh)
+        dht->nr_cache_hits++;
+
+    if (!fresh && (filp->f_flags & O_NONBLOCK))
+    {
+        // 先报告本文件还没看到的失败 (poll 返回的 EPOLLERR)
+        if (mf->err_seq != dht->err_seq && dht->state == DHT_IDLE)
+        {
+            mf->err_seq = dht->err_seq;
+            ret = dht->last_err ? dht->last_err : -EIO;
+        }
+        else
+        {
+            dht_kick(dht);
+            ret = -EAGAIN;
+        }
+        mutex_unlock(&dht->lock);
+        return ret;
+    }
+
+    if (!fresh)
+    {
+        // 缓存过期: 启动一次采集 (已在进行就直接等它)，等待期间不持锁
+        dht_kick(dht);
+        mutex_unlock(&dht->lock);
+
+        ret = wait_for_completion_interruptible(&dht->done);
+        if (ret)
+            return -ERESTARTSYS;
+
+        // 设备移除时也会被唤醒
+        mutex_lock(&dht->lock);
+        if (dht->stopping)
+        {
+            mutex_unlock(&dht->lock);
+            return -ENODEV;
+        }
+
+        // 失败时返回最后一次尝试的原因: -ETIMEDOUT / -EBADMSG
+        if (dht->last_err || !dht->data_valid)
+        {
+            ret = dht->last_err ? dht->last_err : -EIO;
+            mf->err_seq = dht->err_seq;
+            mutex_unlock(&dht->lock);
+            return ret;
+        }
+    }
+
+    dht->profile->legacy(dht->raw, rec.data);
+    rec.timestamp_ns = dht->cached_ns;
+    mf->seq = dht->seq;
+
+    mutex_unlock(&dht->lock);
+
+    rec.age_ms = div_u64(ktime_get_boottime_ns() - rec.timestamp_ns, NSEC_PER_MSEC);
+
+    if (format == DHT_FMT_LEGACY)
+        ret = copy_to_user(buf, rec.data, len);
+    else
+        ret = copy_to_user(buf, &rec, len);
+    return ret ? -EFAULT : len;
+}
+
+/* poll/select/epoll 支持
+ * 有本文件还没读过的新测量时返回 EPOLLIN，最近一次采集失败时返回 EPOLLERR；
+ * 都没有且缓存已过期时顺便启动一次采集，结果到达时唤醒；
+ * 缓存还新鲜时 (按需采集模式) 在过期时刻唤醒一次，否则没有人会启动下一次采集；
+ * 设备移除之后返回 EPOLLHUP | EPOLLERR
+ */
+static __poll_t dht_poll(struct file *filp, struct poll_table_struct *wait)
+{
+    struct dht_file *mf = filp->private_data;
+    struct dht_dev *dht = mf->dht;
+    __poll_t mask = 0;
+
+    poll_wait(filp, &dht->poll_wq, wait);
+
+    mutex_lock(&dht->lock);
+    if (dht->stopping)
+        mask = EPOLLHUP | EPOLLERR;
+    else if (dht->data_valid && mf->seq != dht->seq)
+        mask = EPOLLIN | EPOLLRDNORM;
+    else if (mf->err_seq != dht->err_seq && dht->state == DHT_IDLE)
+        mask = EPOLLERR;
+    else if (!dht_cache_fresh(dht))
+        dht_kick(dht);
+    else if (!period_ms)
+        mod_delayed_work(system_wq, &dht->expire_dwork,
+                         dht->last_read_time + msecs_to_jiffies(DHT_MIN_INTERVAL_MS) - jiffies);
+    mutex_unlock(&dht->lock);
+
+    return mask;
+}
+
+static long dht_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+    struct dht_file *mf = filp->private_data;
+    __u32 __user *uarg = (__u32 __user *)arg;
+    __u32 val;
+
+    switch (cmd)
+    {
+    case DHT_IOC_SET_FORMAT:
+        if (get_user(val, uarg))
+            return -EFAULT;
+        if (val != DHT_FMT_LEGACY && val != DHT_FMT_RECORD && val != DHT_FMT_STATUS)
+            return -EINVAL;
+        WRITE_ONCE(mf->format, val);
+        // 兼容节点上显式设置过格式之后，与 /dev/dht-N 的行为相同
+        WRITE_ONCE(mf->by_length, false);
+        return 0;
+
+    case DHT_IOC_GET_FORMAT:
+        return put_user(READ_ONCE(mf->format), uarg);
+
+    default:
+        return -ENOTTY;
+    }
+}
+
+static int dht_open(struct inode *inode, struct file *filp)
+{
+    // inode->i_cdev 指向 struct cdev 类型的成员
+    // 我们需要获取包含这个 cdev 的整个 dht_dev 结构
+    // 通过结构提成员反推结构体地址的 container_of 宏来实现
+    // 兼容节点的次设备号在 DHT_MAX_DEVICES 之后，对应 legacy_cdev
+    bool by_length = iminor(inode) >= DHT_MAX_DEVICES;
+    struct dht_dev *dht = by_length ? container_of(inode->i_cdev, struct dht_dev, legacy_cdev)
+                                    : container_of(inode->i_cdev, struct dht_dev, cdev);
+    struct dht_file *mf;
+
+    if (READ_ONCE(dht->stopping))
+        return -ENODEV;
+
+    mf = kzalloc(sizeof(*mf), GFP_KERNEL);
+    if (!mf)
+        return -ENOMEM;
+
+    // 已有的缓存对新文件来说是新数据 (seq 从 0 开始)，之前的失败不再报告
+    mf->dht = dht;
+    mf->by_length = by_length;
+    mutex_lock(&dht->lock);
+    mf->err_seq = dht->err_seq;
+    mutex_unlock(&dht->lock);
+
+    // 将文件私有状态保存到
+    // filp->private_data，供其他方法比如read、write等函数使用
+    filp->private_data = mf;
+    return 0;
+}
+
+/* 设备移除之后也只释放本文件的状态，不访问 dht_dev */
+static int dht_release(struct inode *inode, struct file *filp)
+{
+    kfree(filp->private_data);
+    return 0;
+}
+
+static const struct file_operations dht_fops = {
+    .owner = THIS_MODULE,
+    .open = dht_open,
+    .release = dht_release,
+    .read = dht_read,
+    .poll = dht_poll,
+    .unlocked_ioctl = dht_ioctl,
+};
+
+/* debugfs: 高电平脉宽和关中断时长的直方图 */
+static int dht_hist_show(struct seq_file *m, void *v)
+{
+    struct dht_dev *dht = m->private;
+    unsigned int i;
+
+    mutex_lock(&dht->lock);
+
+    seq_puts(m, "high pulse width (us):\n");
+    for (i = 0; i < DHT_PULSE_BUCKETS - 1; i++)
+        seq_printf(m, "  %3u-%-3u %10u\n", i * DHT_PULSE_BUCKET_NS / 1000,
+                   (i + 1) * DHT_PULSE_BUCKET_NS / 1000, dht->pulse_hist[i]);
+    seq_printf(m, "  >=%-5u %10u\n", i * DHT_PULSE_BUCKET_NS / 1000, dht->pulse_hist[i]);
+
+    seq_puts(m, "irq-off per attempt (us):\n");
+    seq_printf(m, "  <1          %10u\n", dht->irqoff_hist[0]);
+    for (i = 1; i < DHT_IRQOFF_BUCKETS - 1; i++)
+        seq_printf(m, "  %5u-%-5u %10u\n", 1U << (i - 1), 1U << i, dht->irqoff_hist[i]);
+    seq_printf(m, "  >=%-9u %10u\n", 1U << (i - 1), dht->irqoff_hist[i]);
+
+    mutex_unlock(&dht->lock);
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(dht_hist);
+
+/* debugfs: 每个传感器一个目录，debugfs 不可用时忽略 */
+static void dht_debugfs_init(struct dht_dev *dht)
+{
+    struct dentry *dir;
+    char name[32];
+    unsigned int i;
+
+    dir = debugfs_create_dir(dev_name(&dht->device), dht_debugfs_root);
+    dht->debugfs = dir;
+
+    debugfs_create_u32("threshold_ns", 0444, dir, &dht->threshold_ns);
+    debugfs_create_u32("preamble_ns", 0444, dir, &dht->preamble_ns);
+    debugfs_create_u32("fixed_threshold", 0444, dir, &dht->nr_fixed_threshold);
+    debugfs_create_u32("captures", 0444, dir, &dht->nr_captures);
+    debugfs_create_u32("attempts", 0444, dir, &dht->nr_attempts);
+    debugfs_create_u32("retries", 0444, dir, &dht->nr_retries);
+    debugfs_create_u32("failures", 0444, dir, &dht->nr_failures);
+    debugfs_create_u32("checksum_errors", 0444, dir, &dht->nr_checksum_errors);
+    debugfs_create_u32("cache_hits", 0444, dir, &dht->nr_cache_hits);
+    for (i = 0; i < DHT_PHASE_NR; i++)
+    {
+        snprintf(name, sizeof(name), "timeouts_%s", dht_phase_names[i]);
+        debugfs_create_u32(name, 0444, dir, &dht->nr_timeouts[i]);
+    }
+    debugfs_create_file("histogram", 0444, dir, dht, &dht_hist_fops);
+}
+
+/* /sys/class/dht/dht-N/model: 传感器型号 */
+static ssize_t model_show(struct device *device, struct device_attribute *attr, char *buf)
+{
+    struct dht_dev *dht = dev_get_drvdata(device);
+
+    return sysfs_emit(buf, "%s\n", dht->profile->name);
+}
+static DEVICE_ATTR_RO(model);
+
+static struct attribute *dht_attrs[] = {
+    &dev_attr_model.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(dht);
+
+/* 旧驱动的兼容节点 /dev/dht11-N、/dev/dht22-N (过渡期间保留，创建失败不影响 /dev/dht-N)
+ * 编号 N 在各自的类中分配，与原来的驱动一致；cdev 同样持有 dht->device 的引用
+ */
+static void dht_legacy_add(struct dht_dev *dht)
+{
+    enum dht_legacy node = dht->profile->legacy_node;
+    dev_t devt = MKDEV(MAJOR(dht_devt), DHT_MAX_DEVICES + dht->minor);
+    struct device *alias;
+    int ret;
+
+    dht->legacy_id = -1;
+    if (!dht_legacy_class[node])
+        return;
+
+    ret = ida_alloc_max(&dht_legacy_ida[node], DHT_MAX_DEVICES - 1, GFP_KERNEL);
+    if (ret < 0)
+        goto fail;
+    dht->legacy_id = ret;
+
+    cdev_init(&dht->legacy_cdev, &dht_fops);
+    dht->legacy_cdev.owner = THIS_MODULE;
+    cdev_set_parent(&dht->legacy_cdev, &dht->device.kobj);
+    ret = cdev_add(&dht->legacy_cdev, devt, 1);
+    if (ret)
+        goto fail_ida;
+
+    alias = device_create(dht_legacy_class[node], &dht->device, devt, dht, "%s-%d",
+                          dht_legacy_names[node], dht->legacy_id);
+    if (IS_ERR(alias))
+    {
+        ret = PTR_ERR(alias);
+        goto fail_cdev;
+    }
+    return;
+
+fail_cdev:
+    cdev_del(&dht->legacy_cdev);
+fail_ida:
+    ida_free(&dht_legacy_ida[node], dht->legacy_id);
+    dht->legacy_id = -1;
+fail:
+    dev_warn(&dht->device, "Failed to create legacy /dev/%s-N node: %d\n", dht_legacy_names[node],
+             ret);
+}
+
+static void dht_legacy_del(struct dht_dev *dht)
+{
+    enum dht_legacy node = dht->profile->legacy_node;
+
+    if (dht->legacy_id < 0)
+        return;
+
+    device_destroy(dht_legacy_class[node], dht->legacy_cdev.dev);
+    cdev_del(&dht->legacy_cdev);
+    ida_free(&dht_legacy_ida[node], dht->legacy_id);
+}
+
+/* 最后一个引用 (设备本身或仍然打开的文件) 释放时调用 */
+static void dht_dev_release(struct device *device)
+{
+    kfree(container_of(device, struct dht_dev, device));
+}
+
+/* 在 probe 开头登记，devm 逆序释放，最后才放掉设备本身的引用:
+ * 中断和 IIO 设备都已经注销，之后只剩打开的文件会访问本结构
+ */
+static void dht_put(void *data)
+{
+    struct dht_dev *dht = data;
+
+    put_device(&dht->device);
+}
+
+static int dht_probe(struct platform_device *pdev)
+{
+    int ret;
+    struct device *dev = &pdev->dev;
+    struct dht_dev *dht;
+
+    // 本结构由 dht->device 的引用计数管理，不能用 devm: 设备移除后仍然打开的文件还会访问它
+    dht = kzalloc(sizeof(*dht), GFP_KERNEL);
+    if (!dht)
+        return -ENOMEM;
+    device_initialize(&dht->device);
+    dht->device.class = dht_class;
+    dht->device.parent = dev;
+    dht->device.groups = dht_groups;
+    dht->device.release = dht_dev_release;
+    dev_set_drvdata(&dht->device, dht);
+    // 从这里开始出错时由 devm 调用 put_device 释放
+    ret = devm_add_action_or_reset(dev, dht_put, dht);
+    if (ret)
+        return ret;
+    platform_set_drvdata(pdev, dht);
+
+    // 型号参数由 compatible 决定；没有设备树节点、按名字匹配的设备 (如 dht_sim 创建的) 由 id_table 决定
+    dht->profile = device_get_match_data(dev);
+    if (!dht->profile && platform_get_device_id(pdev))
+        dht->profile = (const struct dht_profile *)platform_get_device_id(pdev)->driver_data;
+    if (!dht->profile)
+        return -ENODEV;
+
+    // "my,dht11" 原来也是 dht22_drv 的 compatible，两个驱动谁先加载谁就按自己的型号解码
+    if (of_device_is_compatible(dev->of_node, "my,dht11"))
+    {
+        if (legacy_dht22)
+            dht->profile = &dht22_profile;
+        else
+            dev_notice_once(dev, "\"my,dht11\" is decoded as DHT11; boards that used dht22_drv "
+                                 "need \"my,dht22\" or legacy_dht22=1\n");
+    }
+
+    mutex_init(&dht->lock);
+    dht->data_valid = false;
+    INIT_LIST_HEAD(&dht->slot_node);
+    // 注册完成之前不启动采集: 节点创建之后就可能被打开，出错返回时不能留下正在运行的状态机
+    dht->stopping = true;
+
+    // 异步采集状态机
+    INIT_WORK(&dht->work, dht_work);
+    hrtimer_init(&dht->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    dht->timer.function = dht_timer;
+    init_completion(&dht->done);
+    complete_all(&dht->done); // 初始为空闲
+    init_waitqueue_head(&dht->poll_wq);
+    INIT_DELAYED_WORK(&dht->expire_dwork, dht_expire_work);
+
+    // 1. 从DTS获取GPIO ("dht-gpios")
+    // 单总线: 开漏输出，释放时由上拉电阻拉高；数据线同时作为中断使用时也允许拉低
+    dht->gpio = devm_gpiod_get(dev, "data", GPIOD_OUT_HIGH_OPEN_DRAIN);
+    if (IS_ERR(dht->gpio))
+    {
+        dev_err(dev, "Failed to get GPIO\n");
+        return PTR_ERR(dht->gpio);
+    }
+
+    // 边沿中断解码需要数据线能产生中断，并且能在硬中断中读取电平
+    dht->irq = gpiod_to_irq(dht->gpio);
+    if (dht->irq <= 0 || gpiod_cansleep(dht->gpio))
+    {
+        dev_warn(dev, "GPIO has no usable IRQ, falling back to busy-wait decoding\n");
+        dht->irq = 0;
+    }
+
+    // 中断只申请一次，平时关闭，每次接收前后由状态机打开/关闭
+    if (dht->irq > 0)
+    {
+        ret = devm_request_irq(dev, dht->irq, dht_edge_irq,
+                               IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING | IRQF_NO_AUTOEN,
+                               dev_name(dev), dht);
+        if (ret)
+        {
+            dev_warn(dev, "Failed to request IRQ %d (%d), falling back to busy-wait decoding\n",
+                     dht->irq, ret);
+            dht->irq = 0;
+        }
+    }
+
+    // 2. 从共享区间中分配一个空闲的次设备号，注册字符设备
+    dht->minor = ida_alloc_max(&dht_ida, DHT_MAX_DEVICES - 1, GFP_KERNEL);
+    if (dht->minor < 0)
+    {
+        dev_err(dev, "Too many dht devices (max %d)\n", DHT_MAX_DEVICES);
+        return dht->minor;
+    }
+    dht->dev_id = MKDEV(MAJOR(dht_devt), dht->minor);
+    dht->device.devt = dht->dev_id;
+
+    // 3. 创建节点 /dev/dht-N
+    ret = dev_set_name(&dht->device, DEVICE_NAME "-%d", dht->minor);
+    if (ret)
+        goto fail_ida;
+
+    // cdev 持有 dht->device 的引用，打开的文件关闭之前本结构不会被释放
+    cdev_init(&dht->cdev, &dht_fops);
+    dht->cdev.owner = THIS_MODULE;
+    ret = cdev_device_add(&dht->cdev, &dht->device);
+    if (ret)
+        goto fail_ida;
+    dht_legacy_add(dht);
+
+    // 调试信息
+    dht->threshold_ns = DHT_BIT_THRESHOLD_NS;
+    dht_debugfs_init(dht);
+
+    // 注册 IIO 设备 (/sys/bus/iio/devices/iio:deviceX)
+    ret = dht_iio_register(dht, dev);
+    if (ret)
+    {
+        dev_err(dev, "Failed to register IIO device: %d\n", ret);
+        goto fail_device;
+    }
+
+    mutex_lock(&dht->lock);
+    dht->stopping = false;
+    mutex_unlock(&dht->lock);
+
+    // 4. 加入后台采集的轮转，第一个传感器加入时启动轮转
+    mutex_lock(&dht_list_lock);
+    list_add_tail(&dht->node, &dht_list);
+    dht_count++;
+    if (period_ms && dht_count == 1)
+        schedule_delayed_work(&dht_poll_dwork, 0);
+    mutex_unlock(&dht_list_lock);
+
+    dev_info(dev, "%s probed, registered as /dev/" DEVICE_NAME "-%d\n", dht->profile->name,
+             dht->minor);
+    return 0;
+
+fail_device:
+    debugfs_remove_recursive(dht->debugfs);
+    dht_legacy_del(dht);
+    cdev_device_del(&dht->cdev, &dht->device);
+fail_ida:
+    ida_free(&dht_ida, dht->minor);
+    return ret;
+}
+
+/* 停止状态机: 之后不会再启动定时器、工作和中断，仍然打开的文件只能得到 -ENODEV */
+static void dht_stop(struct dht_dev *dht)
+{
+    // 退出后台采集的轮转，持有 dht_list_lock 之后轮转工作不会再访问本设备
+    mutex_lock(&dht_list_lock);
+    list_del(&dht->node);
+    dht_count--;
+    mutex_unlock(&dht_list_lock);
+
+    mutex_lock(&dht->lock);
+    dht->stopping = true;
+    mutex_unlock(&dht->lock);
+
+    // 设置 stopping 之后工作不会再启动定时器、打开中断或申请时间片
+    hrtimer_cancel(&dht->timer);
+    mutex_lock(&dht->lock);
+    dht_capture_stop(dht);
+    mutex_unlock(&dht->lock);
+    dht_slot_put(dht);
+    cancel_work_sync(&dht->work);
+    cancel_delayed_work_sync(&dht->expire_dwork);
+
+    // 唤醒阻塞的读者和 poll/epoll，它们看到 stopping 后返回
+    complete_all(&dht->done);
+    wake_up_interruptible(&dht->poll_wq);
+}
+
+static int dht_remove(struct platform_device *pdev)
+{
+    struct dht_dev *dht = platform_get_drvdata(pdev);
+
+    dht_stop(dht);
+
+    // 之后不会再有新的 open；释放中断、注销 IIO 设备和放掉设备引用都由 devm 按逆序完成
+    debugfs_remove_recursive(dht->debugfs);
+    dht_legacy_del(dht);
+    cdev_device_del(&dht->cdev, &dht->device);
+    ida_free(&dht_ida, dht->minor);
+    return 0;
+}
+
+// 匹配DTS中的 compatible 属性
+// AM2301 (DHT21) 和 AM2302 (带引线的 DHT22) 协议、数据格式都与 DHT22 相同
+static const struct of_device_id dht_match[] = {
+    {.compatible = "my,dht11", .data = &dht11_profile},
+    {.compatible = "my,dht22", .data = &dht22_profile},
+    {.compatible = "my,am2301", .data = &dht22_profile},
+    {.compatible = "my,am2302", .data = &dht22_profile},
+    {/* sentinel */}};
+
+// 设备树中有对应的节点时，系统会自动帮你把驱动加载进内存。
+MODULE_DEVICE_TABLE(of, dht_match);
+
+// 没有设备树节点时按平台设备名匹配 (板级代码或 dht_sim 创建的 <型号>-sensor.N)
+static const struct platform_device_id dht_id_table[] = {
+    {"dht11-sensor", (kernel_ulong_t)&dht11_profile},
+    {"dht22-sensor", (kernel_ulong_t)&dht22_profile},
+    {"am2301-sensor", (kernel_ulong_t)&dht22_profile},
+    {"am2302-sensor", (kernel_ulong_t)&dht22_profile},
+    {/* sentinel */}};
+MODULE_DEVICE_TABLE(platform, dht_id_table);
+
+// 驱动结构体
+static struct platform_driver dht_driver = {
+    .driver =
+        {
+            .name = DRIVER_NAME,
+            .of_match_table = dht_match,
+        },
+    .id_table = dht_id_table,
+    .probe = dht_probe,
+    .remove = dht_remove,
+};
+
+static void dht_legacy_destroy(void)
+{
+    int i;
+
+    for (i = 0; i < DHT_LEGACY_NR; i++)
+    {
+        if (dht_legacy_class[i])
+            class_destroy(dht_legacy_class[i]);
+        ida_destroy(&dht_legacy_ida[i]);
+    }
+}
+
+// 驱动模块入口: 一次申请 2 * DHT_MAX_DEVICES 个设备编号和所有的类，所有传感器共用
+static int __init dht_driver_init(void)
+{
+    int ret;
+    int i;
+
+    ret = alloc_chrdev_region(&dht_devt, 0, 2 * DHT_MAX_DEVICES, DEVICE_NAME);
+    if (ret < 0)
+        return ret;
+
+    dht_class = class_create(THIS_MODULE, CLASS_NAME);
+    if (IS_ERR(dht_class))
+    {
+        ret = PTR_ERR(dht_class);
+        goto fail_region;
+    }
+
+    // 旧驱动的类，类名冲突 (还加载着旧的 dht11_drv / dht22_drv) 时只是不创建兼容节点
+    for (i = 0; i < DHT_LEGACY_NR; i++)
+    {
+        ida_init(&dht_legacy_ida[i]);
+        dht_legacy_class[i] = class_create(THIS_MODULE, dht_legacy_names[i]);
+        if (IS_ERR(dht_legacy_class[i]))
+        {
+            pr_warn(DRIVER_NAME ": legacy class %s unavailable (%ld), no /dev/%s-N nodes\n",
+                    dht_legacy_names[i], PTR_ERR(dht_legacy_class[i]), dht_legacy_names[i]);
+            dht_legacy_class[i] = NULL;
+        }
+    }
+
+    dht_debugfs_root = debugfs_create_dir(DEVICE_NAME, NULL);
+
+    ret = platform_driver_register(&dht_driver);
+    if (ret)
+        goto fail_debugfs;
+
+    return 0;
+
+fail_debugfs:
+    debugfs_remove_recursive(dht_debugfs_root);
+    dht_legacy_destroy();
+    class_destroy(dht_class);
+fail_region:
+    unregister_chrdev_region(dht_devt, 2 * DHT_MAX_DEVICES);
+    return ret;
+}
+
+// 驱动模块出口: 所有传感器移除之后轮转工作不会再重新排队
+static void __exit dht_driver_exit(void)
+{
+    platform_driver_unregister(&dht_driver);
+    cancel_delayed_work_sync(&dht_poll_dwork);
+    debugfs_remove_recursive(dht_debugfs_root);
+    dht_legacy_destroy();
+    class_destroy(dht_class);
+    unregister_chrdev_region(dht_devt, 2 * DHT_MAX_DEVICES);
+    ida_destroy(&dht_ida);
+}
+
+module_init(dht_driver_init);
+module_exit(dht_driver_exit);
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("gm");
@@ -0,0 +1,330 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * 解码基准测试: 配合 dht_sim 模块和 dht_drv 驱动使用
+ * 对每种解码方式 (decode_mode) 连续读取所有模拟传感器，统计成功率、每次 read() 的延迟、
+ * 驱动的重试次数，以及 irqsoff tracer 在各次 read() 期间测到的最长关中断时间 (内核未开启 CONFIG_IRQSOFF_TRACER 时不统计)
+ */
+
+#define MAX_SENSORS 8 // 与 dht_drv 的 DHT_MAX_DEVICES 一致
+#define ROUND_MS 2100 // 驱动两次真正采集至少间隔 2 秒，每轮多等 100ms 保证缓存已过期
+
+static const char *tracing_dirs[] = {"/sys/kernel/tracing", "/sys/kernel/debug/tracing"};
+
+struct bench_result
+{
+    int reads;
+    int ok;       // 数值和模拟器设置的一致
+    int wrong;    // read() 成功但数值不对 (校验和没有发现的错误)
+    int errors;   // read() 返回错误
+    long lat_min_us;
+    long lat_max_us;
+    long long lat_sum_us;
+    long retries; // 驱动 debugfs 中 retries 的增量
+    long irqsoff_us; // 所有 read() 窗口中系统的最长关中断时间，-1 = 不可用
+};
+
+static int read_long(const char *path, long *val)
+{
+    char buf[32];
+    ssize_t n;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return -1;
+    n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0)
+        return -1;
+    buf[n] = '\0';
+    *val = strtol(buf, NULL, 0);
+    return 0;
+}
+
+static int write_str(const char *path, const char *str)
+{
+    ssize_t n;
+    int fd = open(path, O_WRONLY | O_TRUNC);
+
+    if (fd < 0)
+        return -1;
+    n = write(fd, str, strlen(str));
+    close(fd);
+    return n < 0 ? -1 : 0;
+}
+
+static long now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+/* 模拟器当前输出的数值按驱动 read() 的格式编码，和 dht_sim 中的编码保持一致 */
+static size_t expected_bytes(const char *model, uint8_t *buf)
+{
+    long h = 0, t = 0;
+
+    read_long("/sys/module/dht_sim/parameters/humidity", &h);
+    read_long("/sys/module/dht_sim/parameters/temperature", &t);
+
+    if (!strcmp(model, "dht11"))
+    {
+        // [湿度, 温度] 整数部分
+        buf[0] = h / 10;
+        buf[1] = (t < 0 ? 0 : t > 500 ? 500 : t) / 10;
+        return 2;
+    }
+
+    // 原始 4 字节 [湿度高, 湿度低, 温度高, 温度低]
+    if (t < 0)
+        t = 0x8000 | -t;
+    buf[0] = h >> 8;
+    buf[1] = h & 0xFF;
+    buf[2] = t >> 8;
+    buf[3] = t & 0xFF;
+    return 4;
+}
+
+/* 模拟器的第 idx 个传感器 (平台设备 <model>-sensor.idx) 对应的 /dev/dht-N
+ * N 由 dht_drv 按绑定顺序分配，板上还有真实传感器时不一定等于 idx，所以从 /sys/class/dht/dht-N/device 反查
+ */
+static int find_minor(const char *model, int idx)
+{
+    char path[64], link[256], want[32];
+    const char *base;
+    ssize_t n;
+    int minor;
+
+    snprintf(want, sizeof(want), "%s-sensor.%d", model, idx);
+    for (minor = 0; minor < MAX_SENSORS; minor++)
+    {
+        snprintf(path, sizeof(path), "/sys/class/dht/dht-%d/device", minor);
+        n = readlink(path, link, sizeof(link) - 1);
+        if (n <= 0)
+            continue;
+        link[n] = '\0';
+        base = strrchr(link, '/');
+        base = base ? base + 1 : link;
+        if (!strcmp(base, want))
+            return minor;
+    }
+    return -1;
+}
+
+/* 所有传感器 debugfs 中 retries 的和 */
+static long total_retries(const int *minors, int nr)
+{
+    char path[128];
+    long sum = 0, v;
+    int i;
+
+    for (i = 0; i < nr; i++)
+    {
+        snprintf(path, sizeof(path), "/sys/kernel/debug/dht/dht-%d/retries", minors[i]);
+        if (!read_long(path, &v))
+            sum += v;
+    }
+    return sum;
+}
+
+static const char *tracing_dir(void)
+{
+    char path[128];
+    size_t i;
+
+    for (i = 0; i < sizeof(tracing_dirs) / sizeof(tracing_dirs[0]); i++)
+    {
+        snprintf(path, sizeof(path), "%s/tracing_max_latency", tracing_dirs[i]);
+        if (!access(path, W_OK))
+            return tracing_dirs[i];
+    }
+    return NULL;
+}
+
+/* 切换到 irqsoff tracer，返回 0 表示可用 */
+static int irqsoff_start(const char *dir)
+{
+    char path[128];
+
+    if (!dir)
+        return -1;
+    snprintf(path, sizeof(path), "%s/current_tracer", dir);
+    if (write_str(path, "irqsoff"))
+        return -1;
+    snprintf(path, sizeof(path), "%s/tracing_on", dir);
+    write_str(path, "1");
+    return 0;
+}
+
+/* tracing_max_latency 是整个系统的历史最大值，每次 read() 之前清零，只统计这一次采集的时间窗口 */
+static void irqsoff_reset(const char *dir)
+{
+    char path[128];
+
+    snprintf(path, sizeof(path), "%s/tracing_max_latency", dir);
+    write_str(path, "0");
+}
+
+static long irqsoff_read(const char *dir)
+{
+    char path[128];
+    long us = -1;
+
+    snprintf(path, sizeof(path), "%s/tracing_max_latency", dir);
+    read_long(path, &us);
+    return us;
+}
+
+static void irqsoff_stop(const char *dir)
+{
+    char path[128];
+
+    snprintf(path, sizeof(path), "%s/current_tracer", dir);
+    write_str(path, "nop");
+}
+
+static void run_mode(const char *model, int mode, int nr, const int *minors, int *fds, int rounds,
+                     struct bench_result *res)
+{
+    char path[128];
+    char val[8];
+    uint8_t expect[4], buf[4];
+    size_t len = expected_bytes(model, expect);
+    const char *trace = tracing_dir();
+    long start, lat, retries, irqsoff;
+    int r, i;
+    ssize_t n;
+
+    memset(res, 0, sizeof(*res));
+    res->lat_min_us = -1;
+    res->irqsoff_us = -1;
+
+    snprintf(path, sizeof(path), "/sys/module/dht_drv/parameters/decode_mode");
+    snprintf(val, sizeof(val), "%d", mode);
+    if (write_str(path, val))
+        perror("设置 decode_mode 失败");
+
+    // 先等缓存过期，保证每次 read() 都触发一次真正的采集
+    usleep(ROUND_MS * 1000);
+
+    retries = total_retries(minors, nr);
+    if (irqsoff_start(trace))
+        trace = NULL;
+
+    for (r = 0; r < rounds; r++)
+    {
+        long round_start = now_us();
+
+        for (i = 0; i < nr; i++)
+        {
+            if (trace)
+                irqsoff_reset(trace);
+            start = now_us();
+            n = read(fds[i], buf, len);
+            lat = now_us() - start;
+            if (trace)
+            {
+                irqsoff = irqsoff_read(trace);
+                if (irqsoff > res->irqsoff_us)
+                    res->irqsoff_us = irqsoff;
+            }
+
+            res->reads++;
+            if (n != (ssize_t)len)
+                res->errors++;
+            else if (memcmp(buf, expect, len))
+                res->wrong++;
+            else
+                res->ok++;
+
+            if (res->lat_min_us < 0 || lat < res->lat_min_us)
+                res->lat_min_us = lat;
+            if (lat > res->lat_max_us)
+                res->lat_max_us = lat;
+            res->lat_sum_us += lat;
+        }
+
+        lat = now_us() - round_start;
+        if (lat < ROUND_MS * 1000L)
+            usleep(ROUND_MS * 1000L - lat);
+    }
+
+    if (trace)
+        irqsoff_stop(trace);
+    res->retries = total_retries(minors, nr) - retries;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *model = argc > 1 ? argv[1] : "dht11";
+    int rounds = argc > 2 ? atoi(argv[2]) : 30;
+    struct bench_result res;
+    char path[64];
+    int fds[MAX_SENSORS];
+    int minors[MAX_SENSORS];
+    long nr = 0;
+    int i, mode;
+
+    if (strcmp(model, "dht11") && strcmp(model, "dht22"))
+    {
+        fprintf(stderr, "用法: %s [dht11|dht22] [轮数]\n", argv[0]);
+        return -1;
+    }
+
+    if (read_long("/sys/module/dht_sim/parameters/nr_sensors", &nr) || nr <= 0)
+    {
+        fprintf(stderr, "请先加载 dht_sim 模块\n");
+        return -1;
+    }
+    if (nr > MAX_SENSORS)
+        nr = MAX_SENSORS;
+
+    for (i = 0; i < nr; i++)
+    {
+        minors[i] = find_minor(model, i);
+        if (minors[i] < 0)
+        {
+            fprintf(stderr, "%s-sensor.%d 没有绑定 dht_drv，请先加载 dht_drv 模块\n", model, i);
+            return -1;
+        }
+        snprintf(path, sizeof(path), "/dev/dht-%d", minors[i]);
+        fds[i] = open(path, O_RDONLY);
+        if (fds[i] < 0)
+        {
+            fprintf(stderr, "打开 %s 失败: %s\n", path, strerror(errno));
+            return -1;
+        }
+    }
+
+    printf("%s x %ld, %d 轮 (约 %d 秒/模式)\n\n", model, nr, rounds, rounds * ROUND_MS / 1000);
+    printf("%-12s %6s %8s %6s %6s %24s %8s %14s\n", "decode_mode", "reads", "ok", "wrong", "errors",
+           "latency min/avg/max ms", "retries", "sys irqsoff us");
+
+    for (mode = 0; mode <= 1; mode++)
+    {
+        run_mode(model, mode, nr, minors, fds, rounds, &res);
+
+        printf("%-12s %6d %7.1f%% %6d %6d %8.1f/%6.1f/%8.1f %8ld ",
+               mode ? "1 (irq)" : "0 (poll)", res.reads,
+               res.reads ? 100.0 * res.ok / res.reads : 0.0, res.wrong, res.errors,
+               res.lat_min_us / 1000.0, res.reads ? res.lat_sum_us / 1000.0 / res.reads : 0.0,
+               res.lat_max_us / 1000.0, res.retries);
+        if (res.irqsoff_us >= 0)
+            printf("%14ld\n", res.irqsoff_us);
+        else
+            printf("%14s\n", "n/a");
+    }
+
+    for (i = 0; i < nr; i++)
+        close(fds[i]);
+    return 0;
+}
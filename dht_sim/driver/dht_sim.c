@@ -0,0 +1,588 @@
+#include <linux/atomic.h>
+#include <linux/debugfs.h>
+#include <linux/gpio/driver.h>
+#include <linux/gpio/machine.h>
+#include <linux/hrtimer.h>
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/irq_sim.h>
+#include <linux/irqdomain.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/platform_device.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/timekeeping.h>
+
+/*
+ * DHT11/DHT22 波形模拟器
+ *
+ * 注册一个模拟 GPIO 控制器 (思路同内核的 gpio-sim: 中断由 irq_sim 产生)，每根线模拟一个传感器，
+ * 再创建 dht11-sensor.N / dht22-sensor.N 平台设备，并通过 GPIO lookup 表把 "data"
+ * 映射到这些线上，dht_drv 按 id_table 中的名字选择型号参数，不需要修改设备树就能绑定上来。
+ *
+ * 被测驱动拉低数据线并释放后，模拟器按当前参数生成一帧完整的波形 (每个边沿的时间和电平)：
+ * - 读取电平时按当前时间在波形中查找，关中断忙等的解码方式也能读到正确的电平；
+ * - hrtimer 在每个边沿到期时触发模拟中断，边沿中断解码方式按真实的中断延迟记录时间戳。
+ *
+ * 抖动、整体伸缩、毛刺、错误校验和、不响应都可以通过模块参数在运行时调整。
+ */
+
+#define DRIVER_NAME "dht-sim"          // 模拟 GPIO 控制器的名字，也是 lookup 表中的 key
+#define DHT_SIM_MAX_SENSORS 8
+#define DHT_SIM_MAX_EDGES 96           // 一帧 84 个边沿，毛刺最多再加 2 个
+
+// 传感器时序 (ns)，见 DHT11/DHT22 手册
+#define DHT_SIM_RESPONSE_NS 30000      // 主机释放总线后 20~40us 开始响应
+#define DHT_SIM_PREAMBLE_NS 80000      // 响应: 低 80us + 高 80us
+#define DHT_SIM_BIT_LOW_NS 50000       // 每位之前的低电平
+#define DHT_SIM_BIT0_NS 27000          // 0: 高 26~28us
+#define DHT_SIM_BIT1_NS 70000          // 1: 高 70us
+#define DHT_SIM_MIN_GAP_NS 1000        // 加抖动后相邻边沿至少间隔 1us
+
+static char *model = "dht11";
+module_param(model, charp, 0444);
+MODULE_PARM_DESC(model, "Sensor model to emulate: dht11 or dht22 (selects the dht_drv profile)");
+
+static unsigned int nr_sensors = 1;
+module_param(nr_sensors, uint, 0444);
+MODULE_PARM_DESC(nr_sensors, "Number of emulated sensors (1-8)");
+
+// 以下参数可以在运行时通过 /sys/module/dht_sim/parameters/ 修改，从下一帧开始生效
+static unsigned int humidity = 550;
+module_param(humidity, uint, 0644);
+MODULE_PARM_DESC(humidity, "Reported humidity in 0.1 %RH");
+
+static int temperature = 235;
+module_param(temperature, int, 0644);
+MODULE_PARM_DESC(temperature, "Reported temperature in 0.1 C (negative values only for dht22)");
+
+static unsigned int jitter_ns = 2000;
+module_param(jitter_ns, uint, 0644);
+MODULE_PARM_DESC(jitter_ns, "Uniform random jitter applied to every edge, +/- ns");
+
+static unsigned int scale_pct = 100;
+module_param(scale_pct, uint, 0644);
+MODULE_PARM_DESC(scale_pct, "Stretch (>100) or shrink (<100) every pulse width, in percent");
+
+static unsigned int glitch_pct;
+module_param(glitch_pct, uint, 0644);
+MODULE_PARM_DESC(glitch_pct, "Chance per frame of a short low glitch inside one data bit, in percent");
+
+static unsigned int glitch_ns = 3000;
+module_param(glitch_ns, uint, 0644);
+MODULE_PARM_DESC(glitch_ns, "Width of an injected glitch in ns");
+
+static unsigned int bad_checksum_pct;
+module_param(bad_checksum_pct, uint, 0644);
+MODULE_PARM_DESC(bad_checksum_pct, "Chance per frame of a corrupted checksum byte, in percent");
+
+static unsigned int no_response_pct;
+module_param(no_response_pct, uint, 0644);
+MODULE_PARM_DESC(no_response_pct, "Chance per start signal of no response at all, in percent");
+
+/* 每个型号的差异 */
+struct dht_sim_model
+{
+    const char *name;
+    const char *driver;          // 平台设备名，对应 dht_drv id_table 中的型号
+    unsigned int min_start_us;   // 起始信号至少拉低这么久传感器才响应
+    void (*encode)(u8 *data);    // 把 humidity/temperature 编成前 4 个字节
+};
+
+/* DHT11: 湿度、温度各一个整数字节，小数字节为 0 */
+static void dht_sim_encode_dht11(u8 *data)
+{
+    data[0] = READ_ONCE(humidity) / 10;
+    data[1] = 0;
+    data[2] = clamp(READ_ONCE(temperature), 0, 500) / 10;
+    data[3] = 0;
+}
+
+/* DHT22: 16 位湿度、16 位温度，单位 0.1，温度最高位为符号位 */
+static void dht_sim_encode_dht22(u8 *data)
+{
+    unsigned int h = READ_ONCE(humidity);
+    int t = READ_ONCE(temperature);
+    u16 traw = t < 0 ? (0x8000 | (u16)-t) : (u16)t;
+
+    data[0] = h >> 8;
+    data[1] = h & 0xFF;
+    data[2] = traw >> 8;
+    data[3] = traw & 0xFF;
+}
+
+static const struct dht_sim_model dht_sim_models[] = {
+    {.name = "dht11", .driver = "dht11-sensor", .min_start_us = 18000, .encode = dht_sim_encode_dht11},
+    {.name = "dht22", .driver = "dht22-sensor", .min_start_us = 1000, .encode = dht_sim_encode_dht22},
+};
+
+struct dht_sim;
+
+/* 一个模拟的传感器 (一根 GPIO 线) */
+struct dht_sim_sensor
+{
+    struct dht_sim *sim;
+    unsigned int offset;
+    spinlock_t lock;                // 保护下面所有字段，会在硬中断上下文中使用
+    bool output;                    // 被测驱动把这根线设成了输出
+    int out_value;                  // 输出时驱动的电平
+    u64 low_start_ns;               // 开始拉低的时刻，0 = 没有在拉低
+    struct hrtimer timer;           // 每个边沿到期时触发模拟中断
+
+    // 当前一帧的波形，edge_ns 为绝对时间 (ktime_get_ns)
+    unsigned int nedges;
+    unsigned int next_edge;         // 下一个要触发中断的边沿
+    u64 edge_ns[DHT_SIM_MAX_EDGES];
+    u8 edge_level[DHT_SIM_MAX_EDGES];
+};
+
+struct dht_sim
+{
+    const struct dht_sim_model *model;
+    struct platform_device *pdev;   // 模拟 GPIO 控制器所在的设备
+    struct gpio_chip gc;
+    struct fwnode_handle *fwnode;
+    struct irq_domain *irq_sim;
+    struct gpiod_lookup_table *lookup[DHT_SIM_MAX_SENSORS];    // 每个传感器一张 lookup 表
+    struct platform_device *sensors_pdev[DHT_SIM_MAX_SENSORS]; // 被测驱动绑定的设备
+    struct dht_sim_sensor sensors[DHT_SIM_MAX_SENSORS];
+    struct dentry *debugfs;
+
+    // 统计，通过 /sys/kernel/debug/dht_sim/ 查看
+    atomic_t frames;                // 生成的帧数
+    atomic_t short_starts;          // 起始信号太短、没有响应的次数
+    atomic_t no_responses;          // 按 no_response_pct 故意不响应的次数
+    atomic_t glitches;              // 注入毛刺的帧数
+    atomic_t bad_checksums;         // 注入错误校验和的帧数
+};
+
+static struct dht_sim *dht_sim;
+
+/* 0 ~ 99 的随机数小于 pct 时返回 true */
+static bool dht_sim_chance(unsigned int pct)
+{
+    return pct && get_random_u32() % 100 < pct;
+}
+
+/* 按 scale_pct 伸缩一段时长 */
+static u64 dht_sim_scale(u64 ns)
+{
+    return div_u64(ns * READ_ONCE(scale_pct), 100);
+}
+
+/* 追加一个边沿: 在上一个边沿之后 ns 纳秒 (加抖动) 变为 level */
+static void dht_sim_add_edge(struct dht_sim_sensor *s, u64 *t, u64 ns, int level)
+{
+    unsigned int jitter = READ_ONCE(jitter_ns);
+    u64 at = *t + dht_sim_scale(ns);
+    s64 delta = 0;
+
+    if (s->nedges >= DHT_SIM_MAX_EDGES)
+        return;
+
+    // 抖动只加在这个边沿上，不累积到后面的边沿
+    if (jitter)
+        delta = (s64)(get_random_u32() % (2 * jitter + 1)) - jitter;
+    *t = at;
+
+    at += delta;
+    if (s->nedges && at < s->edge_ns[s->nedges - 1] + DHT_SIM_MIN_GAP_NS)
+        at = s->edge_ns[s->nedges - 1] + DHT_SIM_MIN_GAP_NS;
+
+    s->edge_ns[s->nedges] = at;
+    s->edge_level[s->nedges] = level;
+    s->nedges++;
+}
+
+/* 主机在 t0 释放总线，生成之后的一整帧波形并启动定时器，调用者需持有 s->lock */
+static void dht_sim_build_frame(struct dht_sim_sensor *s, u64 t0)
+{
+    struct dht_sim *sim = s->sim;
+    u8 data[5];
+    int glitch_bit = -1;
+    u64 t = t0;
+    int i;
+
+    s->nedges = 0;
+    s->next_edge = 0;
+
+    if (dht_sim_chance(READ_ONCE(no_response_pct)))
+    {
+        atomic_inc(&sim->no_responses);
+        return;
+    }
+
+    sim->model->encode(data);
+    data[4] = data[0] + data[1] + data[2] + data[3];
+    if (dht_sim_chance(READ_ONCE(bad_checksum_pct)))
+    {
+        data[4] ^= 1 << (get_random_u32() % 8);
+        atomic_inc(&sim->bad_checksums);
+    }
+    if (dht_sim_chance(READ_ONCE(glitch_pct)))
+    {
+        glitch_bit = get_random_u32() % 40;
+        atomic_inc(&sim->glitches);
+    }
+
+    // 响应和前导脉冲
+    dht_sim_add_edge(s, &t, DHT_SIM_RESPONSE_NS, 0);
+    dht_sim_add_edge(s, &t, DHT_SIM_PREAMBLE_NS, 1);
+    dht_sim_add_edge(s, &t, DHT_SIM_PREAMBLE_NS, 0);
+
+    // 40 位数据，高位在前
+    for (i = 0; i < 40; i++)
+    {
+        u64 high = (data[i / 8] & (1 << (7 - i % 8))) ? DHT_SIM_BIT1_NS : DHT_SIM_BIT0_NS;
+
+        dht_sim_add_edge(s, &t, DHT_SIM_BIT_LOW_NS, 1);
+        if (i == glitch_bit)
+        {
+            // 在高电平中间插入一个短暂的低电平
+            u64 glitch = min_t(u64, READ_ONCE(glitch_ns), high / 2);
+
+            dht_sim_add_edge(s, &t, (high - glitch) / 2, 0);
+            dht_sim_add_edge(s, &t, glitch, 1);
+            high -= (high - glitch) / 2 + glitch;
+        }
+        dht_sim_add_edge(s, &t, high, 0);
+    }
+
+    // 结束: 低 50us 后释放总线
+    dht_sim_add_edge(s, &t, DHT_SIM_BIT_LOW_NS, 1);
+
+    atomic_inc(&sim->frames);
+    hrtimer_start(&s->timer, ns_to_ktime(s->edge_ns[0]), HRTIMER_MODE_ABS);
+}
+
+/* 主机停止拉低 (释放总线或输出高电平)，拉低时间足够时开始响应，调用者需持有 s->lock */
+static void dht_sim_release(struct dht_sim_sensor *s)
+{
+    u64 now = ktime_get_ns();
+
+    if (!s->low_start_ns)
+        return;
+
+    if (now - s->low_start_ns >= (u64)s->sim->model->min_start_us * NSEC_PER_USEC)
+        dht_sim_build_frame(s, now);
+    else
+        atomic_inc(&s->sim->short_starts);
+    s->low_start_ns = 0;
+}
+
+/* 传感器在当前时刻输出的电平，没有波形时由上拉电阻拉高，调用者需持有 s->lock */
+static int dht_sim_level(struct dht_sim_sensor *s, u64 now)
+{
+    int level = 1;
+    unsigned int i;
+
+    for (i = 0; i < s->nedges && s->edge_ns[i] <= now; i++)
+        level = s->edge_level[i];
+
+    return level;
+}
+
+/* 每个边沿到期时触发模拟中断 (硬中断上下文)，已经过期的边沿一起触发，和真实的中断延迟一样会合并 */
+static enum hrtimer_restart dht_sim_timer(struct hrtimer *timer)
+{
+    struct dht_sim_sensor *s = container_of(timer, struct dht_sim_sensor, timer);
+    unsigned long flags;
+    u64 now = ktime_get_ns();
+    bool fire = false;
+    int irq;
+
+    spin_lock_irqsave(&s->lock, flags);
+    while (s->next_edge < s->nedges && s->edge_ns[s->next_edge] <= now)
+    {
+        s->next_edge++;
+        fire = true;
+    }
+    if (s->next_edge < s->nedges)
+        hrtimer_start(&s->timer, ns_to_ktime(s->edge_ns[s->next_edge]), HRTIMER_MODE_ABS);
+    spin_unlock_irqrestore(&s->lock, flags);
+
+    // 中断没有被申请时 irq_sim 会忽略这次触发
+    irq = irq_find_mapping(s->sim->irq_sim, s->offset);
+    if (fire && irq > 0)
+        irq_set_irqchip_state(irq, IRQCHIP_STATE_PENDING, true);
+
+    return HRTIMER_NORESTART;
+}
+
+static int dht_sim_get_direction(struct gpio_chip *gc, unsigned int offset)
+{
+    struct dht_sim *sim = gpiochip_get_data(gc);
+
+    return sim->sensors[offset].output ? GPIO_LINE_DIRECTION_OUT : GPIO_LINE_DIRECTION_IN;
+}
+
+static int dht_sim_direction_input(struct gpio_chip *gc, unsigned int offset)
+{
+    struct dht_sim *sim = gpiochip_get_data(gc);
+    struct dht_sim_sensor *s = &sim->sensors[offset];
+    unsigned long flags;
+
+    spin_lock_irqsave(&s->lock, flags);
+    s->output = false;
+    dht_sim_release(s);
+    spin_unlock_irqrestore(&s->lock, flags);
+    return 0;
+}
+
+static void dht_sim_set(struct gpio_chip *gc, unsigned int offset, int value)
+{
+    struct dht_sim *sim = gpiochip_get_data(gc);
+    struct dht_sim_sensor *s = &sim->sensors[offset];
+    unsigned long flags;
+
+    spin_lock_irqsave(&s->lock, flags);
+    if (s->output)
+    {
+        if (!value && !s->low_start_ns)
+        {
+            // 主机开始拉低: 放弃还没发完的一帧
+            hrtimer_try_to_cancel(&s->timer);
+            s->nedges = 0;
+            s->low_start_ns = ktime_get_ns();
+        }
+        else if (value)
+        {
+            dht_sim_release(s);
+        }
+    }
+    s->out_value = value;
+    spin_unlock_irqrestore(&s->lock, flags);
+}
+
+static int dht_sim_direction_output(struct gpio_chip *gc, unsigned int offset, int value)
+{
+    struct dht_sim *sim = gpiochip_get_data(gc);
+    struct dht_sim_sensor *s = &sim->sensors[offset];
+    unsigned long flags;
+
+    spin_lock_irqsave(&s->lock, flags);
+    s->output = true;
+    spin_unlock_irqrestore(&s->lock, flags);
+
+    dht_sim_set(gc, offset, value);
+    return 0;
+}
+
+static int dht_sim_get(struct gpio_chip *gc, unsigned int offset)
+{
+    struct dht_sim *sim = gpiochip_get_data(gc);
+    struct dht_sim_sensor *s = &sim->sensors[offset];
+    unsigned long flags;
+    int level;
+
+    spin_lock_irqsave(&s->lock, flags);
+    level = s->output ? s->out_value : dht_sim_level(s, ktime_get_ns());
+    spin_unlock_irqrestore(&s->lock, flags);
+    return level;
+}
+
+static int dht_sim_to_irq(struct gpio_chip *gc, unsigned int offset)
+{
+    struct dht_sim *sim = gpiochip_get_data(gc);
+
+    return irq_create_mapping(sim->irq_sim, offset);
+}
+
+/* 删除前 n 个传感器的平台设备和 lookup 表 */
+static void dht_sim_remove_sensors(struct dht_sim *sim, unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++)
+    {
+        if (sim->sensors_pdev[i])
+            platform_device_unregister(sim->sensors_pdev[i]);
+        gpiod_remove_lookup_table(sim->lookup[i]);
+        kfree(sim->lookup[i]->dev_id);
+        kfree(sim->lookup[i]);
+    }
+}
+
+/* 为每个传感器创建被测驱动的平台设备，"data" 映射到对应的模拟线上
+ * 平台设备按名字和 dht_drv 的 id_table 匹配，probe 可能在注册时同步进行，所以先添加 lookup 表
+ */
+static int dht_sim_add_sensors(struct dht_sim *sim)
+{
+    struct gpiod_lookup_table *lookup;
+    struct platform_device *pdev;
+    unsigned int i;
+    int ret;
+
+    for (i = 0; i < nr_sensors; i++)
+    {
+        lookup = kzalloc(struct_size(lookup, table, 2), GFP_KERNEL);
+        if (!lookup)
+        {
+            ret = -ENOMEM;
+            goto fail;
+        }
+
+        // lookup 表按设备名 "<driver>.<id>" 匹配，最后一项为空
+        lookup->dev_id = kasprintf(GFP_KERNEL, "%s.%u", sim->model->driver, i);
+        if (!lookup->dev_id)
+        {
+            kfree(lookup);
+            ret = -ENOMEM;
+            goto fail;
+        }
+        lookup->table[0] =
+            (struct gpiod_lookup)GPIO_LOOKUP_IDX(DRIVER_NAME, i, "data", 0, GPIO_ACTIVE_HIGH);
+        gpiod_add_lookup_table(lookup);
+        sim->lookup[i] = lookup;
+
+        pdev = platform_device_register_simple(sim->model->driver, i, NULL, 0);
+        if (IS_ERR(pdev))
+        {
+            ret = PTR_ERR(pdev);
+            i++; // 本传感器的 lookup 表也要删除
+            goto fail;
+        }
+        sim->sensors_pdev[i] = pdev;
+    }
+    return 0;
+
+fail:
+    dht_sim_remove_sensors(sim, i);
+    return ret;
+}
+
+static int __init dht_sim_init(void)
+{
+    struct dht_sim *sim;
+    unsigned int i;
+    int ret;
+
+    if (!nr_sensors || nr_sensors > DHT_SIM_MAX_SENSORS)
+        return -EINVAL;
+
+    sim = kzalloc(sizeof(*sim), GFP_KERNEL);
+    if (!sim)
+        return -ENOMEM;
+
+    for (i = 0; i < ARRAY_SIZE(dht_sim_models); i++)
+    {
+        if (!strcmp(model, dht_sim_models[i].name))
+            sim->model = &dht_sim_models[i];
+    }
+    if (!sim->model)
+    {
+        pr_err("dht_sim: unknown model '%s'\n", model);
+        ret = -EINVAL;
+        goto fail_free;
+    }
+
+    for (i = 0; i < nr_sensors; i++)
+    {
+        struct dht_sim_sensor *s = &sim->sensors[i];
+
+        s->sim = sim;
+        s->offset = i;
+        s->out_value = 1;
+        spin_lock_init(&s->lock);
+        hrtimer_init(&s->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+        s->timer.function = dht_sim_timer;
+    }
+
+    sim->pdev = platform_device_register_simple(DRIVER_NAME, -1, NULL, 0);
+    if (IS_ERR(sim->pdev))
+    {
+        ret = PTR_ERR(sim->pdev);
+        goto fail_free;
+    }
+
+    // 模拟中断控制器，和 gpio-sim 一样用 irq_sim 实现
+    sim->fwnode = irq_domain_alloc_named_fwnode(DRIVER_NAME);
+    if (!sim->fwnode)
+    {
+        ret = -ENOMEM;
+        goto fail_pdev;
+    }
+
+    sim->irq_sim = irq_domain_create_sim(sim->fwnode, nr_sensors);
+    if (IS_ERR(sim->irq_sim))
+    {
+        ret = PTR_ERR(sim->irq_sim);
+        goto fail_fwnode;
+    }
+
+    // 模拟 GPIO 控制器，电平读写不会睡眠，可以在关中断和硬中断中使用
+    sim->gc.label = DRIVER_NAME;
+    sim->gc.parent = &sim->pdev->dev;
+    sim->gc.owner = THIS_MODULE;
+    sim->gc.base = -1;
+    sim->gc.ngpio = nr_sensors;
+    sim->gc.can_sleep = false;
+    sim->gc.get_direction = dht_sim_get_direction;
+    sim->gc.direction_input = dht_sim_direction_input;
+    sim->gc.direction_output = dht_sim_direction_output;
+    sim->gc.get = dht_sim_get;
+    sim->gc.set = dht_sim_set;
+    sim->gc.to_irq = dht_sim_to_irq;
+
+    ret = gpiochip_add_data(&sim->gc, sim);
+    if (ret)
+        goto fail_irq_sim;
+
+    sim->debugfs = debugfs_create_dir("dht_sim", NULL);
+    debugfs_create_atomic_t("frames", 0444, sim->debugfs, &sim->frames);
+    debugfs_create_atomic_t("short_starts", 0444, sim->debugfs, &sim->short_starts);
+    debugfs_create_atomic_t("no_responses", 0444, sim->debugfs, &sim->no_responses);
+    debugfs_create_atomic_t("glitches", 0444, sim->debugfs, &sim->glitches);
+    debugfs_create_atomic_t("bad_checksums", 0444, sim->debugfs, &sim->bad_checksums);
+
+    ret = dht_sim_add_sensors(sim);
+    if (ret)
+        goto fail_gpiochip;
+
+    dht_sim = sim;
+    pr_info("dht_sim: %u emulated %s sensor(s) as %s.N, bind with dht_drv\n", nr_sensors,
+            sim->model->name, sim->model->driver);
+    return 0;
+
+fail_gpiochip:
+    debugfs_remove_recursive(sim->debugfs);
+    gpiochip_remove(&sim->gc);
+fail_irq_sim:
+    irq_domain_remove_sim(sim->irq_sim);
+fail_fwnode:
+    irq_domain_free_fwnode(sim->fwnode);
+fail_pdev:
+    platform_device_unregister(sim->pdev);
+fail_free:
+    kfree(sim);
+    return ret;
+}
+
+static void __exit dht_sim_exit(void)
+{
+    struct dht_sim *sim = dht_sim;
+    unsigned int i;
+
+    // 先解绑被测驱动，之后不会再有人访问模拟线
+    dht_sim_remove_sensors(sim, nr_sensors);
+    debugfs_remove_recursive(sim->debugfs);
+    gpiochip_remove(&sim->gc);
+
+    for (i = 0; i < nr_sensors; i++)
+        hrtimer_cancel(&sim->sensors[i].timer);
+
+    irq_domain_remove_sim(sim->irq_sim);
+    irq_domain_free_fwnode(sim->fwnode);
+    platform_device_unregister(sim->pdev);
+    kfree(sim);
+}
+
+module_init(dht_sim_init);
+module_exit(dht_sim_exit);
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("gm");
+MODULE_DESCRIPTION("DHT11/DHT22 waveform emulator on a simulated GPIO chip");
@@ -5,31 +5,49 @@
 #include <stdint.h>
 #include <math.h>
 #include <string.h>
+#include <stdlib.h>
 
-struct mpu6050_sensor_data
+// 必须与驱动层保持一致
+#define MPU6050_IOC_MAGIC 'M'
+#define MPU6050_IOC_SET_OUTPUT _IOW(MPU6050_IOC_MAGIC, 2, uint32_t)
+#define MPU6050_OUTPUT_SI 1
+
+// 驱动内按当前量程换算好的定点值
+struct mpu6050_si_data
 {
-    int16_t accel_x;
-    int16_t accel_y;
-    int16_t accel_z;
-    int16_t temp;
-    int16_t gyro_x;
-    int16_t gyro_y;
-    int16_t gyro_z;
+    int32_t accel_x; // mg
+    int32_t accel_y;
+    int32_t accel_z;
+    int32_t temp;    // m°C
+    int32_t gyro_x;  // mdps
+    int32_t gyro_y;
+    int32_t gyro_z;
 };
-int main(void)
+int main(int argc, char *argv[])
 {
     int fd;
-    struct mpu6050_sensor_data data;
+    struct mpu6050_si_data data;
+    uint32_t output = MPU6050_OUTPUT_SI;
     int ret;
+    // 每个传感器对应一个 /dev/mpu6050-N，默认读第一个
+    const char *path = argc > 1 ? argv[1] : "/dev/mpu6050-0";
 
-    fd = open("/dev/mpu6050", O_RDONLY);
+    fd = open(path, O_RDONLY);
     if (fd < 0)
     {
         perror("无法打开MPU6050设备");
         return -1;
     }
 
-    printf("MPU6050传感器测试\n");
+    // 让驱动直接输出 mg / mdps / m°C，应用层不需要再做浮点换算
+    if (ioctl(fd, MPU6050_IOC_SET_OUTPUT, &output) < 0)
+    {
+        perror("设置输出格式失败");
+        close(fd);
+        return -1;
+    }
+
+    printf("MPU6050传感器测试: %s\n", path);
 
     while (1)
     {
@@ -42,7 +60,8 @@ int main(void)
         }
 
         printf("加速度: X=%d mg, Y=%d mg, Z=%d mg | \r\n", data.accel_x, data.accel_y, data.accel_z);
-        printf("温度: %f °C | \r\n", (data.temp / 340.0) + 36.53);
+        printf("温度: %s%d.%03d °C | \r\n", data.temp < 0 ? "-" : "", abs(data.temp) / 1000,
+               abs(data.temp) % 1000);
         printf("陀螺仪: X=%d mdps, Y=%d mdps, Z=%d mdps\r\n", data.gyro_x, data.gyro_y, data.gyro_z);
 
         usleep(500000); // 延时500ms
@@ -9,9 +9,18 @@
 #include <linux/regulator/consumer.h>
 #include <linux/miscdevice.h>
 #include <linux/jiffies.h>
+#include <linux/idr.h>
+#include <linux/moduleparam.h>
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
+#include <linux/wait.h>
+#include <linux/spinlock.h>
+#include <linux/timekeeping.h>
 
 #define DEV_NAME "mpu6050"
-#define DEV_CNT 1
+#define MPU6050_MAX_DEVICES 8 /* 最多支持的传感器数量，每个占一个次设备号 */
+#define MPU6050_RING_SIZE 64  /* 定时采样模式缓存的样本数，必须是 2 的幂 */
+#define MPU6050_POLL_RATE_MAX 1000 /* 定时采样最高频率 (Hz)，等于芯片输出数据率 */
 #define MPU6050_I2C_ADDR 0x68
 
 #define MPU6050_SMPLRT_DIV 0x19
@@ -61,22 +70,41 @@
 #define MPU6050_TEMP_DENOM 340       /* LSB/°C */
 #define MPU6050_TEMP_OFFSET_mC 36530 /* 36.53°C in milli-deg C */
 
-struct mpu6050_dev
+/* --- ioctl 接口 (用户态需保持一致) --- */
+#define MPU6050_IOC_MAGIC 'M'
+#define MPU6050_IOC_REINIT _IO(MPU6050_IOC_MAGIC, 1) /* 复位芯片并重写缓存的配置 */
+#define MPU6050_IOC_SET_OUTPUT _IOW(MPU6050_IOC_MAGIC, 2, uint32_t)
+#define MPU6050_IOC_GET_OUTPUT _IOR(MPU6050_IOC_MAGIC, 3, uint32_t)
+#define MPU6050_IOC_SET_RATE _IOW(MPU6050_IOC_MAGIC, 4, uint32_t) /* 定时采样频率 Hz，0 = 按需读取 */
+#define MPU6050_IOC_GET_RATE _IOR(MPU6050_IOC_MAGIC, 5, uint32_t)
+
+/* read() 输出格式，按打开的文件分别设置 */
+#define MPU6050_OUTPUT_RAW 0 /* struct mpu6050_sensor_data，原始计数 (默认) */
+#define MPU6050_OUTPUT_SI 1  /* struct mpu6050_si_data，按当前量程换算好的定点值 */
+#define MPU6050_OUTPUT_TS 2  /* struct mpu6050_ts_data，原始计数 + 采样时间戳 */
+
+/* 没有 INT 引脚的板子由内核按固定频率采样，0 表示保持按需读取 */
+static unsigned int poll_rate_hz;
+module_param(poll_rate_hz, uint, 0444);
+MODULE_PARM_DESC(poll_rate_hz, "Kernel-side sampling rate in Hz, 0 = sample on read (max 1000)");
+
+/* 设备状态：probe 中完成初始化后进入 READY，I2C 出错后进入 ERROR，
+ * 下一次访问或 MPU6050_IOC_REINIT 时重新初始化
+ */
+enum mpu6050_state
 {
-    struct i2c_client *client;
-    dev_t devid;            /* 设备号 */
-    struct cdev cdev;       /* cdev */
-    struct class *class;    /* 类 */
-    struct device *device;  /* 设备 */
-    struct device_node *nd; /* 设备节点 */
-    // void *private_data;      /* 私有数据 */
-    /* 互斥锁 */
-    struct mutex lock;
-
-    bool initialized;
+    MPU6050_STATE_UNINIT,
+    MPU6050_STATE_READY,
+    MPU6050_STATE_ERROR,
 };
 
-static struct mpu6050_dev mpu6050dev;
+/* 缓存的配置寄存器，重新初始化时原样写回 */
+struct mpu6050_regs
+{
+    uint8_t smplrt_div;
+    uint8_t accel_config;
+    uint8_t gyro_config;
+};
 
 struct mpu6050_sensor_data
 {
@@ -89,6 +117,104 @@ struct mpu6050_sensor_data
     int16_t gyro_z;
 };
 
+/* 定时采样缓存中的一个样本 */
+struct mpu6050_ring_entry
+{
+    uint64_t timestamp_ns;           /* CLOCK_BOOTTIME 采样时刻 */
+    struct mpu6050_sensor_data raw;
+    uint8_t accel_config;            /* 采样时的量程寄存器，用于 SI 换算 */
+    uint8_t gyro_config;
+};
+
+struct mpu6050_dev
+{
+    struct i2c_client *client;
+    dev_t devid;            /* 设备号 */
+    int minor;              /* 次设备号，也是 /dev/mpu6050-N 中的 N */
+    struct cdev cdev;       /* cdev */
+    /* 设备 /dev/mpu6050-N，本结构随它的引用计数释放：
+     * 打开的文件通过 cdev 持有引用，设备解绑之后也不会访问已释放的内存
+     */
+    struct device device;
+    struct device_node *nd; /* 设备节点 */
+    // void *private_data;      /* 私有数据 */
+    /* 互斥锁，每个设备一把，不同总线上的传感器可以并行读取；保护下面的状态和 I2C 访问 */
+    struct mutex lock;
+
+    enum mpu6050_state state;
+    struct mpu6050_regs regs;
+    bool dead;              /* 设备已解绑，仍然打开的文件只能得到 -ENODEV；受 lock 保护 */
+
+    /* --- 内核定时采样 --- */
+    /* hrtimer 按计划时刻触发，I2C 读取放到高优先级工作队列中完成 */
+    struct mutex rate_lock;        /* 串行化采样频率切换 */
+    unsigned int poll_rate;        /* 当前采样频率，0 = 按需读取 */
+    u64 poll_period_ns;
+    struct hrtimer poll_timer;
+    struct work_struct poll_work;
+    wait_queue_head_t read_wq;
+    spinlock_t ring_lock;          /* 保护 poll_stamp、head、ring 和读者游标 */
+    u64 poll_stamp;                /* 本次采样的计划时刻 (定时器到期时间) */
+    u32 head;                      /* 已写入样本总数，槽位为 head & (MPU6050_RING_SIZE - 1) */
+    struct mpu6050_ring_entry ring[MPU6050_RING_SIZE];
+};
+
+/* 每个打开的文件各自的状态 */
+struct mpu6050_file
+{
+    struct mpu6050_dev *dev;
+    uint32_t output; /* MPU6050_OUTPUT_* */
+    u32 cursor;      /* 定时采样模式下下一个要读的样本序号 */
+};
+
+/* 所有实例共用一个设备号区间和一个类，次设备号由 IDA 分配 */
+static dev_t mpu6050_devt;
+static struct class *mpu6050_class;
+static DEFINE_IDA(mpu6050_ida);
+
+/* MPU6050_OUTPUT_SI 格式 */
+struct mpu6050_si_data
+{
+    int32_t accel_x; /* mg */
+    int32_t accel_y;
+    int32_t accel_z;
+    int32_t temp;    /* m°C */
+    int32_t gyro_x;  /* mdps */
+    int32_t gyro_y;
+    int32_t gyro_z;
+};
+
+/* MPU6050_OUTPUT_TS 格式 */
+struct mpu6050_ts_data
+{
+    uint64_t timestamp_ns; /* CLOCK_BOOTTIME，定时采样模式下是等间隔的计划时刻 */
+    struct mpu6050_sensor_data data;
+    uint16_t reserved;
+};
+
+/* 各种输出格式的共用缓冲 */
+union mpu6050_output_data
+{
+    struct mpu6050_sensor_data raw;
+    struct mpu6050_si_data si;
+    struct mpu6050_ts_data ts;
+};
+
+/* 量程档位 (ACCEL_CONFIG/GYRO_CONFIG bit4:3) 对应的换算分母 */
+static const int mpu6050_accel_denom[] = {
+    MPU6050_ACCEL_DENOM_2G,
+    MPU6050_ACCEL_DENOM_4G,
+    MPU6050_ACCEL_DENOM_8G,
+    MPU6050_ACCEL_DENOM_16G,
+};
+
+static const int mpu6050_gyro_denom10[] = {
+    MPU6050_GYRO_DENOM10_250DPS,
+    MPU6050_GYRO_DENOM10_500DPS,
+    MPU6050_GYRO_DENOM10_1000DPS,
+    MPU6050_GYRO_DENOM10_2000DPS,
+};
+
 static int mpu6050_write_reg(struct mpu6050_dev *dev, uint8_t reg, uint8_t val)
 {
     uint8_t buf[2] = {reg, val};
@@ -187,108 +313,396 @@ static int mpu6050_read_sensor_data(struct mpu6050_dev *dev, struct mpu6050_sens
     return 0;
 }
 
+/* 完整初始化: 检查 WHO_AM_I，复位芯片 (100ms) 并写入缓存的配置
+ * 只在 probe、MPU6050_IOC_REINIT 和 I2C 出错后调用，调用者需持有 dev->lock
+ */
 static int mpu6050_init(struct mpu6050_dev *dev)
 {
     uint8_t who_am_i;
     int ret;
 
+    dev->state = MPU6050_STATE_ERROR;
+
     /* Check WHO_AM_I register */
     ret = mpu6050_read_reg(dev, MPU6050_WHO_AM_I, &who_am_i);
     if (ret < 0)
     {
         printk("mpu6050: Failed to read WHO_AM_I register\n");
-        return -1;
+        return -EIO;
     }
 
     if (who_am_i != MPU6050_WHO_AM_I_ID)
     {
         printk("mpu6050: WHO_AM_I mismatch: expected 0x%02x, got 0x%02x\n", MPU6050_WHO_AM_I_ID, who_am_i);
-        return -1;
+        return -ENODEV;
     }
     printk("mpu6050: WHO_AM_I register OK: 0x%02x\n", who_am_i);
 
     /* Reset device */
     ret = mpu6050_write_reg(dev, MPU6050_PWR_MGMT_1, 0x80); // 复位设备
     if (ret)
-        return ret;
+        return -EIO;
 
     msleep(100);
 
     /* Wake up device and select clock source */
     ret = mpu6050_write_reg(dev, MPU6050_PWR_MGMT_1, 0x00); // 选择内部时钟
     if (ret < 0)
-        return -1;
+        return -EIO;
 
-    /* Set sample rate to 1kHz by writing SMPLRT_DIV register */
-    ret = mpu6050_write_reg(dev, MPU6050_SMPLRT_DIV, 0x07);
+    /* 采样率、加速度计和陀螺仪配置，取自缓存 */
+    ret = mpu6050_write_reg(dev, MPU6050_SMPLRT_DIV, dev->regs.smplrt_div);
     if (ret < 0)
-        return -1;
+        return -EIO;
 
-    /* Set accelerometer range to ±2g */
-    ret = mpu6050_write_reg(dev, MPU6050_ACCEL_CONFIG, 0x06);
+    ret = mpu6050_write_reg(dev, MPU6050_ACCEL_CONFIG, dev->regs.accel_config);
     if (ret < 0)
-        return -1;
+        return -EIO;
 
-    /* Set gyroscope range to ±250°/s */
-    ret = mpu6050_write_reg(dev, MPU6050_GYRO_CONFIG, 0x01);
+    ret = mpu6050_write_reg(dev, MPU6050_GYRO_CONFIG, dev->regs.gyro_config);
     if (ret < 0)
-        return -1;
+        return -EIO;
 
-    dev->initialized = true;
+    dev->state = MPU6050_STATE_READY;
     printk("mpu6050: Initialization complete\n");
 
     return 0;
 }
 
+/* 原始计数 -> mg / mdps / m°C，accel_config/gyro_config 为采样时的寄存器值
+ * 中间结果最大 32767 * 10000，不会溢出 32 位
+ */
+static void mpu6050_to_si(const struct mpu6050_sensor_data *raw, uint8_t accel_config,
+                          uint8_t gyro_config, struct mpu6050_si_data *si)
+{
+    int accel_denom = mpu6050_accel_denom[(accel_config >> 3) & 0x03];
+    int gyro_denom10 = mpu6050_gyro_denom10[(gyro_config >> 3) & 0x03];
+
+    si->accel_x = raw->accel_x * 1000 / accel_denom;
+    si->accel_y = raw->accel_y * 1000 / accel_denom;
+    si->accel_z = raw->accel_z * 1000 / accel_denom;
+    si->temp = raw->temp * 1000 / MPU6050_TEMP_DENOM + MPU6050_TEMP_OFFSET_mC;
+    /* denom10 是 LSB/(°/s) 的 10 倍: mdps = raw * 1000 * 10 / denom10 */
+    si->gyro_x = raw->gyro_x * 10000 / gyro_denom10;
+    si->gyro_y = raw->gyro_y * 10000 / gyro_denom10;
+    si->gyro_z = raw->gyro_z * 10000 / gyro_denom10;
+}
+
+/* 确保设备处于 READY 状态，上次出错时在这里重新初始化，调用者需持有 dev->lock */
+static int mpu6050_ensure_ready(struct mpu6050_dev *dev)
+{
+    if (dev->state == MPU6050_STATE_READY)
+        return 0;
+
+    dev_warn_ratelimited(&dev->client->dev, "re-initializing after error\n");
+    return mpu6050_init(dev);
+}
+
 /*字符设备操作函数集，open函数实现*/
+/* 硬件已在 probe 中初始化，open 不访问总线，也不会打断其他进程的读取 */
 static int mpu6050_open(struct inode *inode, struct file *filp)
 {
-    filp->private_data = &mpu6050dev;
-    printk("mpu6050: Device opened\n");
-    mpu6050_init(&mpu6050dev);
+    struct mpu6050_dev *dev = container_of(inode->i_cdev, struct mpu6050_dev, cdev);
+    struct mpu6050_file *mf;
+
+    if (READ_ONCE(dev->dead))
+        return -ENODEV;
+
+    mf = kzalloc(sizeof(*mf), GFP_KERNEL);
+    if (!mf)
+        return -ENOMEM;
+
+    mf->dev = dev;
+    mf->output = MPU6050_OUTPUT_RAW;
+    /* 定时采样模式下只读打开之后的样本 */
+    mf->cursor = READ_ONCE(dev->head);
+    filp->private_data = mf;
     return 0;
 }
-/*字符设备操作函数集，.read函数实现*/
-static ssize_t mpu6050_read(struct file *filp, char __user *buf, size_t cnt, loff_t *off)
+static size_t mpu6050_output_size(uint32_t output)
+{
+    switch (output)
+    {
+    case MPU6050_OUTPUT_SI:
+        return sizeof(struct mpu6050_si_data);
+    case MPU6050_OUTPUT_TS:
+        return sizeof(struct mpu6050_ts_data);
+    default:
+        return sizeof(struct mpu6050_sensor_data);
+    }
+}
+
+/* 把一个样本按输出格式转换到 out 中 */
+static void mpu6050_format(uint32_t output, const struct mpu6050_ring_entry *e,
+                           union mpu6050_output_data *out)
+{
+    switch (output)
+    {
+    case MPU6050_OUTPUT_SI:
+        mpu6050_to_si(&e->raw, e->accel_config, e->gyro_config, &out->si);
+        break;
+    case MPU6050_OUTPUT_TS:
+        memset(&out->ts, 0, sizeof(out->ts));
+        out->ts.timestamp_ns = e->timestamp_ns;
+        out->ts.data = e->raw;
+        break;
+    default:
+        out->raw = e->raw;
+        break;
+    }
+}
+
+/* 采一个样本，调用者需持有 dev->lock；总线出错时标记 ERROR，下次访问重新初始化 */
+static int mpu6050_sample(struct mpu6050_dev *dev, struct mpu6050_ring_entry *e)
 {
-    struct mpu6050_dev *dev = (struct mpu6050_dev *)filp->private_data;
-    struct mpu6050_sensor_data raw_data;
     int ret;
 
-    /* We copy raw_data to userspace, so validate against its size */
-    if (cnt < sizeof(raw_data))
-        return -EINVAL;
+    if (dev->dead)
+        return -ENODEV;
+
+    ret = mpu6050_ensure_ready(dev);
+    if (ret)
+        return ret;
+
+    /* Read raw sensor data */
+    if (mpu6050_read_sensor_data(dev, &e->raw) < 0)
+    {
+        dev->state = MPU6050_STATE_ERROR;
+        return -EIO;
+    }
+    /* 换算用采样时的量程 */
+    e->accel_config = dev->regs.accel_config;
+    e->gyro_config = dev->regs.gyro_config;
+    return 0;
+}
+
+/* --- 内核定时采样 ---
+ * hrtimer 在硬中断上下文按绝对时间到期，只记录计划时刻并排队工作；
+ * 工作函数读取传感器，把样本连同计划时刻放入缓存。时间戳取计划时刻而不是读取时刻，
+ * 样本间隔严格相等，不受调度和 I2C 延迟影响
+ */
+static enum hrtimer_restart mpu6050_poll_timer(struct hrtimer *timer)
+{
+    struct mpu6050_dev *dev = container_of(timer, struct mpu6050_dev, poll_timer);
+
+    spin_lock(&dev->ring_lock);
+    dev->poll_stamp = ktime_to_ns(hrtimer_get_expires(timer));
+    spin_unlock(&dev->ring_lock);
+
+    queue_work(system_highpri_wq, &dev->poll_work);
+
+    /* 按周期推进，错过的周期直接跳过，不会累积漂移 */
+    hrtimer_forward_now(timer, ns_to_ktime(dev->poll_period_ns));
+    return HRTIMER_RESTART;
+}
+
+static void mpu6050_poll_work(struct work_struct *work)
+{
+    struct mpu6050_dev *dev = container_of(work, struct mpu6050_dev, poll_work);
+    struct mpu6050_ring_entry e;
+    unsigned long flags;
+    int ret;
+
+    spin_lock_irqsave(&dev->ring_lock, flags);
+    e.timestamp_ns = dev->poll_stamp;
+    spin_unlock_irqrestore(&dev->ring_lock, flags);
 
     mutex_lock(&dev->lock);
+    ret = mpu6050_sample(dev, &e);
+    mutex_unlock(&dev->lock);
+    if (ret)
+        return;
+
+    spin_lock_irqsave(&dev->ring_lock, flags);
+    dev->ring[dev->head & (MPU6050_RING_SIZE - 1)] = e;
+    dev->head++;
+    spin_unlock_irqrestore(&dev->ring_lock, flags);
+
+    wake_up_interruptible(&dev->read_wq);
+}
 
-    if (!dev->initialized)
+/* 切换采样频率，0 = 停止定时采样 */
+static int mpu6050_set_rate(struct mpu6050_dev *dev, unsigned int rate)
+{
+    if (rate > MPU6050_POLL_RATE_MAX)
+        return -EINVAL;
+
+    mutex_lock(&dev->rate_lock);
+    /* 解绑时先置 dead 再停止采样，之后不能再重新启动 */
+    if (rate && READ_ONCE(dev->dead))
     {
-        mutex_unlock(&dev->lock);
+        mutex_unlock(&dev->rate_lock);
         return -ENODEV;
     }
+    hrtimer_cancel(&dev->poll_timer);
+    cancel_work_sync(&dev->poll_work);
 
-    /* Read raw sensor data */
-    ret = mpu6050_read_sensor_data(dev, &raw_data);
-    if (ret < 0)
+    WRITE_ONCE(dev->poll_rate, rate);
+    if (rate)
     {
-        mutex_unlock(&dev->lock);
-        return ret;
+        dev->poll_period_ns = div_u64(NSEC_PER_SEC, rate);
+        hrtimer_start(&dev->poll_timer, ktime_add_ns(ktime_get_boottime(), dev->poll_period_ns),
+                      HRTIMER_MODE_ABS);
     }
+    mutex_unlock(&dev->rate_lock);
+
+    /* 停止采样时唤醒阻塞的读者，让它们退回按需读取 */
+    wake_up_interruptible(&dev->read_wq);
+    return 0;
+}
+
+static bool mpu6050_ring_has_data(struct mpu6050_file *mf)
+{
+    return READ_ONCE(mf->dev->head) != READ_ONCE(mf->cursor);
+}
 
-    /* Copy raw sensor data to user buffer */
-    if (copy_to_user(buf, &raw_data, sizeof(raw_data)))
+/* 从缓存中取出本文件未读的样本，落后超过缓存深度时跳到最旧的有效样本 */
+static unsigned int mpu6050_ring_fetch(struct mpu6050_file *mf, struct mpu6050_ring_entry *out,
+                                       unsigned int max)
+{
+    struct mpu6050_dev *dev = mf->dev;
+    unsigned long flags;
+    unsigned int i, n;
+    u32 avail;
+
+    spin_lock_irqsave(&dev->ring_lock, flags);
+    avail = dev->head - mf->cursor;
+    if (avail > MPU6050_RING_SIZE)
     {
-        mutex_unlock(&dev->lock);
-        return -EFAULT;
+        mf->cursor = dev->head - MPU6050_RING_SIZE;
+        avail = MPU6050_RING_SIZE;
     }
 
+    n = min_t(u32, avail, max);
+    for (i = 0; i < n; i++)
+        out[i] = dev->ring[(mf->cursor + i) & (MPU6050_RING_SIZE - 1)];
+    mf->cursor += n;
+    spin_unlock_irqrestore(&dev->ring_lock, flags);
+
+    return n;
+}
+
+/* 定时采样模式的 read：阻塞到有新样本，一次取走缓冲区能放下的所有样本
+ * 返回 0 表示采样已经停止，由调用者退回按需读取
+ */
+static ssize_t mpu6050_read_ring(struct file *filp, char __user *buf, size_t cnt)
+{
+    struct mpu6050_file *mf = filp->private_data;
+    struct mpu6050_dev *dev = mf->dev;
+    struct mpu6050_ring_entry batch[8];
+    union mpu6050_output_data out;
+    size_t unit = mpu6050_output_size(mf->output);
+    size_t want = cnt / unit;
+    size_t done = 0;
+    unsigned int n, i;
+    int ret;
+
+    if (!mpu6050_ring_has_data(mf) && (filp->f_flags & O_NONBLOCK))
+        return -EAGAIN;
+
+    ret = wait_event_interruptible(dev->read_wq,
+                                   mpu6050_ring_has_data(mf) || !READ_ONCE(dev->poll_rate));
+    if (ret)
+        return -ERESTARTSYS;
+
+    /* copy_to_user 可能睡眠，不能在自旋锁内执行，所以分批中转 */
+    while (done < want)
+    {
+        n = mpu6050_ring_fetch(mf, batch, min_t(size_t, want - done, ARRAY_SIZE(batch)));
+        if (n == 0)
+            break;
+
+        for (i = 0; i < n; i++)
+        {
+            mpu6050_format(mf->output, &batch[i], &out);
+            if (copy_to_user(buf + (done + i) * unit, &out, unit))
+                return done + i ? (done + i) * unit : -EFAULT;
+        }
+        done += n;
+    }
+
+    return done * unit;
+}
+
+/*字符设备操作函数集，.read函数实现*/
+static ssize_t mpu6050_read(struct file *filp, char __user *buf, size_t cnt, loff_t *off)
+{
+    struct mpu6050_file *mf = filp->private_data;
+    struct mpu6050_dev *dev = mf->dev;
+    struct mpu6050_ring_entry e;
+    union mpu6050_output_data out;
+    size_t unit = mpu6050_output_size(mf->output);
+    ssize_t ret;
+
+    /* 按本文件的输出格式检查用户缓冲区大小 */
+    if (cnt < unit)
+        return -EINVAL;
+
+    if (READ_ONCE(dev->poll_rate))
+    {
+        ret = mpu6050_read_ring(filp, buf, cnt);
+        if (ret)
+            return ret;
+    }
+
+    /* 按需读取：同步读一次传感器 */
+    mutex_lock(&dev->lock);
+    e.timestamp_ns = ktime_get_boottime_ns();
+    ret = mpu6050_sample(dev, &e);
     mutex_unlock(&dev->lock);
-    return sizeof(raw_data);
+    if (ret)
+        return ret;
+
+    mpu6050_format(mf->output, &e, &out);
+    if (copy_to_user(buf, &out, unit))
+        return -EFAULT;
+
+    return unit;
+}
+/*字符设备操作函数集，.unlocked_ioctl函数实现*/
+static long mpu6050_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+    struct mpu6050_file *mf = filp->private_data;
+    struct mpu6050_dev *dev = mf->dev;
+    uint32_t __user *uarg = (uint32_t __user *)arg;
+    uint32_t val;
+    int ret;
+
+    switch (cmd)
+    {
+    case MPU6050_IOC_REINIT:
+        mutex_lock(&dev->lock);
+        ret = dev->dead ? -ENODEV : mpu6050_init(dev);
+        mutex_unlock(&dev->lock);
+        return ret;
+
+    case MPU6050_IOC_SET_OUTPUT:
+        if (get_user(val, uarg))
+            return -EFAULT;
+        if (val != MPU6050_OUTPUT_RAW && val != MPU6050_OUTPUT_SI && val != MPU6050_OUTPUT_TS)
+            return -EINVAL;
+        mf->output = val;
+        return 0;
+
+    case MPU6050_IOC_GET_OUTPUT:
+        return put_user(mf->output, uarg);
+
+    case MPU6050_IOC_SET_RATE:
+        if (get_user(val, uarg))
+            return -EFAULT;
+        return mpu6050_set_rate(dev, val);
+
+    case MPU6050_IOC_GET_RATE:
+        return put_user(READ_ONCE(dev->poll_rate), uarg);
+
+    default:
+        return -ENOTTY;
+    }
 }
 /*字符设备操作函数集，.release函数实现*/
 static int mpu6050_release(struct inode *inode, struct file *filp)
 {
-    printk("mpu6050: Device closed\n");
+    kfree(filp->private_data);
     return 0;
 }
 /*字符设备操作函数集*/
@@ -297,52 +711,123 @@ static struct file_operations mpu6050_chr_dev_fops =
         .owner = THIS_MODULE,
         .open = mpu6050_open,
         .read = mpu6050_read,
+        .unlocked_ioctl = mpu6050_ioctl,
         .release = mpu6050_release,
 };
 
+/* 最后一个引用 (设备本身或仍然打开的文件) 释放时调用 */
+static void mpu6050_dev_release(struct device *device)
+{
+    kfree(container_of(device, struct mpu6050_dev, device));
+}
+
 /*i2c总线设备函数集*/
 static int mpu6050_probe(struct i2c_client *client, const struct i2c_device_id *id)
 {
-    mutex_init(&mpu6050dev.lock);
-    printk("mpu6050 driver and device matched!\r\n");
-    // 采用动态分配的方式，获取设备编号，次设备号为0，
-    // 设备名称mpu6050，可通过命令cat  /proc/devices查看
-    // DEV_CNT为1，当前只申请一个设备编号
-    if (alloc_chrdev_region(&mpu6050dev.devid, 0, DEV_CNT, DEV_NAME) < 0)
-    {
-        printk("mpu6050: Failed to allocate char dev region\n");
-        return -1;
-    }
+    struct mpu6050_dev *dev;
+    int ret;
 
-    cdev_init(&mpu6050dev.cdev, &mpu6050_chr_dev_fops);
-    cdev_add(&mpu6050dev.cdev, mpu6050dev.devid, DEV_CNT);
+    printk("mpu6050 driver and device matched!\r\n");
 
-    mpu6050dev.class = class_create(THIS_MODULE, DEV_NAME);
-    if (IS_ERR(mpu6050dev.class))
+    /* 每个设备的状态由 dev->device 的引用计数管理，不能用 devm：
+     * 设备移除后仍然打开的文件还会访问它
+     */
+    dev = kzalloc(sizeof(*dev), GFP_KERNEL);
+    if (!dev)
+        return -ENOMEM;
+
+    /* 从这里开始出错都用 put_device 释放 */
+    device_initialize(&dev->device);
+    dev->device.class = mpu6050_class;
+    dev->device.parent = &client->dev;
+    dev->device.release = mpu6050_dev_release;
+    dev_set_drvdata(&dev->device, dev);
+
+    mutex_init(&dev->lock);
+    dev->client = client;
+    i2c_set_clientdata(client, dev);
+
+    /* 定时采样 */
+    mutex_init(&dev->rate_lock);
+    spin_lock_init(&dev->ring_lock);
+    init_waitqueue_head(&dev->read_wq);
+    INIT_WORK(&dev->poll_work, mpu6050_poll_work);
+    /* 与 ktime_get_boottime 同一时钟，挂起期间时间戳也连续 */
+    hrtimer_init(&dev->poll_timer, CLOCK_BOOTTIME, HRTIMER_MODE_ABS);
+    dev->poll_timer.function = mpu6050_poll_timer;
+
+    /* 默认配置: 1kHz/(1+7) 采样率, ±2g, ±250°/s */
+    dev->regs.smplrt_div = 0x07;
+    dev->regs.accel_config = 0x06;
+    dev->regs.gyro_config = 0x01;
+
+    /* 硬件初始化只在这里做一次，之后 open 不再复位芯片 */
+    mutex_lock(&dev->lock);
+    ret = mpu6050_init(dev);
+    mutex_unlock(&dev->lock);
+    if (ret)
     {
-        unregister_chrdev_region(mpu6050dev.devid, DEV_CNT);
-        return PTR_ERR(mpu6050dev.class);
+        dev_err(&client->dev, "Failed to init MPU6050: %d\n", ret);
+        goto err_put;
     }
 
-    mpu6050dev.device = device_create(mpu6050dev.class, NULL, mpu6050dev.devid, NULL, DEV_NAME);
-    if (IS_ERR(mpu6050dev.device))
+    /* 从共享区间中分配一个空闲的次设备号 */
+    dev->minor = ida_alloc_max(&mpu6050_ida, MPU6050_MAX_DEVICES - 1, GFP_KERNEL);
+    if (dev->minor < 0)
     {
-        class_destroy(mpu6050dev.class);
-        unregister_chrdev_region(mpu6050dev.devid, DEV_CNT);
-        return PTR_ERR(mpu6050dev.device);
+        dev_err(&client->dev, "Too many mpu6050 devices (max %d)\n", MPU6050_MAX_DEVICES);
+        ret = dev->minor;
+        goto err_put;
     }
+    dev->devid = MKDEV(MAJOR(mpu6050_devt), dev->minor);
+    dev->device.devt = dev->devid;
+
+    /* 设备节点 /dev/mpu6050-N */
+    ret = dev_set_name(&dev->device, DEV_NAME "-%d", dev->minor);
+    if (ret)
+        goto err_ida;
+
+    /* cdev 持有 dev->device 的引用，打开的文件关闭之前本结构不会被释放 */
+    cdev_init(&dev->cdev, &mpu6050_chr_dev_fops);
+    dev->cdev.owner = THIS_MODULE;
+    ret = cdev_device_add(&dev->cdev, &dev->device);
+    if (ret)
+        goto err_ida;
 
-    mpu6050dev.client = client;
+    dev_info(&client->dev, "registered as /dev/" DEV_NAME "-%d\n", dev->minor);
 
+    if (poll_rate_hz)
+    {
+        ret = mpu6050_set_rate(dev, min_t(unsigned int, poll_rate_hz, MPU6050_POLL_RATE_MAX));
+        if (!ret)
+            dev_info(&client->dev, "sampling at %u Hz\n", dev->poll_rate);
+    }
     return 0;
+
+err_ida:
+    ida_free(&mpu6050_ida, dev->minor);
+err_put:
+    put_device(&dev->device);
+    return ret;
 }
 static void mpu6050_remove(struct i2c_client *client)
 {
-    /*删除设备*/
-    device_destroy(mpu6050dev.class, mpu6050dev.devid);
-    class_destroy(mpu6050dev.class);
-    cdev_del(&mpu6050dev.cdev);
-    unregister_chrdev_region(mpu6050dev.devid, DEV_CNT);
+    struct mpu6050_dev *dev = i2c_get_clientdata(client);
+
+    /*删除设备，之后不会再有新的 open*/
+    cdev_device_del(&dev->cdev, &dev->device);
+
+    /* 已经打开的文件还在，标记为 dead 之后它们不再访问总线 */
+    mutex_lock(&dev->lock);
+    dev->dead = true;
+    mutex_unlock(&dev->lock);
+
+    /* 停止定时采样，并唤醒阻塞的读者让它们返回 -ENODEV */
+    mpu6050_set_rate(dev, 0);
+
+    ida_free(&mpu6050_ida, dev->minor);
+    /* 最后一个打开的文件关闭时才真正释放 */
+    put_device(&dev->device);
 }
 
 /* 传统匹配方式 ID 列表 */
@@ -373,7 +858,33 @@ struct i2c_driver mpu6050_driver = {
 static int __init mpu6050_driver_init(void)
 {
     int ret = 0;
+
+    // 采用动态分配的方式，一次申请 MPU6050_MAX_DEVICES 个设备编号，所有传感器共用
+    // 设备名称mpu6050，可通过命令cat  /proc/devices查看
+    ret = alloc_chrdev_region(&mpu6050_devt, 0, MPU6050_MAX_DEVICES, DEV_NAME);
+    if (ret < 0)
+    {
+        printk("mpu6050: Failed to allocate char dev region\n");
+        return ret;
+    }
+
+    mpu6050_class = class_create(THIS_MODULE, DEV_NAME);
+    if (IS_ERR(mpu6050_class))
+    {
+        ret = PTR_ERR(mpu6050_class);
+        goto err_region;
+    }
+
     ret = i2c_add_driver(&mpu6050_driver);
+    if (ret)
+        goto err_class;
+
+    return 0;
+
+err_class:
+    class_destroy(mpu6050_class);
+err_region:
+    unregister_chrdev_region(mpu6050_devt, MPU6050_MAX_DEVICES);
     return ret;
 }
 
@@ -383,6 +894,9 @@ static int __init mpu6050_driver_init(void)
 static void __exit mpu6050_driver_exit(void)
 {
     i2c_del_driver(&mpu6050_driver);
+    class_destroy(mpu6050_class);
+    unregister_chrdev_region(mpu6050_devt, MPU6050_MAX_DEVICES);
+    ida_destroy(&mpu6050_ida);
 }
 
 module_init(mpu6050_driver_init);
@@ -4,7 +4,7 @@
 #include <unistd.h>
 #include <stdint.h>
 #include <math.h>
-#include <sys/time.h>
+#include <sys/ioctl.h>
 
 #define RAD_TO_DEG 57.295779513082320876
 
@@ -91,19 +91,28 @@ struct mpu_raw_data
     uint8_t gyro_z_l;
 };
 
-double get_time_sec()
+/* MPU6050_FMT_SAMPLE 格式: 原始帧 + 硬中断时间戳 */
+struct mpu_sample
 {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec + tv.tv_usec / 1000000.0;
-}
+    uint64_t timestamp_ns; // CLOCK_BOOTTIME，驱动在硬中断中记录
+    struct mpu_raw_data raw;
+    uint8_t accel_fs; // ±(2 << accel_fs) g
+    uint8_t gyro_fs;  // ±(250 << gyro_fs) dps
+};
 
-int main(int argc, char *argv[])
+#define MPU6050_IOC_MAGIC 'M'
+#define MPU6050_IOC_SET_FORMAT _IOW(MPU6050_IOC_MAGIC, 1, uint32_t)
+#define MPU6050_FMT_SAMPLE 1
+
+int main(void)
 {
     int fd;
+    struct mpu_sample sample;
     struct mpu_raw_data raw;
+    uint32_t fmt = MPU6050_FMT_SAMPLE;
     short ax_raw, ay_raw, az_raw, gx_raw, gy_raw, gz_raw, temp_raw;
     float ax, ay, az, gx, gy, gz, temp_c;
+    float accel_lsb, gyro_lsb; // 每 g / 每 dps 对应的 LSB，随帧上的量程标记变化
 
     // 零点偏移量
     float gyro_bias_x = 0, gyro_bias_y = 0, gyro_bias_z = 0;
@@ -113,7 +122,8 @@ int main(int argc, char *argv[])
     Kalman_Init(&kalmanX);
     Kalman_Init(&kalmanY);
 
-    double last_time, current_time, dt;
+    uint64_t last_ts = 0; // 上一个样本的时间戳，0 = 还没有样本
+    double dt;
 
     fd = open("/dev/mpu6050", O_RDONLY);
     if (fd < 0)
@@ -122,38 +132,55 @@ int main(int argc, char *argv[])
         return -1;
     }
 
+    // 使用带时间戳的读取格式，dt 由驱动记录的硬中断时间计算，不受调度延迟影响
+    if (ioctl(fd, MPU6050_IOC_SET_FORMAT, &fmt) < 0)
+    {
+        perror("Set format failed");
+        close(fd);
+        return -1;
+    }
+
     // --- 1. 启动时的零点校准 ---
     printf("Keep sensor still! Calibrating gyro...\n");
-    long gx_sum = 0, gy_sum = 0, gz_sum = 0;
+    double gx_sum = 0, gy_sum = 0, gz_sum = 0;
     const int CALIB_COUNT = 500;
+    int calib_ok = 0; // 成功读到的样本数
 
     for (int i = 0; i < CALIB_COUNT; i++)
     {
-        if (read(fd, &raw, sizeof(raw)) == sizeof(raw))
+        if (read(fd, &sample, sizeof(sample)) == sizeof(sample))
         {
-            gx_sum += (short)((raw.gyro_x_h << 8) | raw.gyro_x_l);
-            gy_sum += (short)((raw.gyro_y_h << 8) | raw.gyro_y_l);
-            gz_sum += (short)((raw.gyro_z_h << 8) | raw.gyro_z_l);
-            usleep(2000); // 稍微延时，等待新数据
+            raw = sample.raw;
+            gyro_lsb = 131.0f / (1 << sample.gyro_fs);
+            gx_sum += (short)((raw.gyro_x_h << 8) | raw.gyro_x_l) / gyro_lsb;
+            gy_sum += (short)((raw.gyro_y_h << 8) | raw.gyro_y_l) / gyro_lsb;
+            gz_sum += (short)((raw.gyro_z_h << 8) | raw.gyro_z_l) / gyro_lsb;
+            last_ts = sample.timestamp_ns;
+            calib_ok++;
         }
     }
-    // 计算平均偏差
-    gyro_bias_x = (float)gx_sum / CALIB_COUNT / 131.0f;
-    gyro_bias_y = (float)gy_sum / CALIB_COUNT / 131.0f;
-    gyro_bias_z = (float)gz_sum / CALIB_COUNT / 131.0f;
+    if (calib_ok == 0)
+    {
+        perror("Calibration failed, no samples");
+        close(fd);
+        return -1;
+    }
+    // 计算平均偏差 (只算成功读到的样本)
+    gyro_bias_x = gx_sum / calib_ok;
+    gyro_bias_y = gy_sum / calib_ok;
+    gyro_bias_z = gz_sum / calib_ok;
     printf("Calibration Done! Bias X:%.3f Y:%.3f Z:%.3f\n", gyro_bias_x, gyro_bias_y, gyro_bias_z);
     // -------------------------
 
     printf("Starting Kalman Filter Fusion...\n");
-    last_time = get_time_sec();
 
     while (1)
     {
-        if (read(fd, &raw, sizeof(raw)) == sizeof(raw))
+        if (read(fd, &sample, sizeof(sample)) == sizeof(sample))
         {
-            current_time = get_time_sec();
-            dt = current_time - last_time;
-            last_time = current_time;
+            raw = sample.raw;
+            dt = (sample.timestamp_ns - last_ts) / 1e9;
+            last_ts = sample.timestamp_ns;
             if (dt <= 0)
                 dt = 0.01; // 防止除零
 
@@ -166,13 +193,15 @@ int main(int argc, char *argv[])
             gz_raw = (raw.gyro_z_h << 8) | raw.gyro_z_l;
             temp_raw = (raw.temp_h << 8) | raw.temp_l;
 
-            // 物理单位转换 & 减去零点偏差
-            ax = ax_raw / 16384.0f;
-            ay = ay_raw / 16384.0f;
-            az = az_raw / 16384.0f;
-            gx = (gx_raw / 131.0f) - gyro_bias_x;
-            gy = (gy_raw / 131.0f) - gyro_bias_y;
-            gz = (gz_raw / 131.0f) - gyro_bias_z;
+            // 物理单位转换 & 减去零点偏差，系数取自驱动标记的采样时量程
+            accel_lsb = 16384.0f / (1 << sample.accel_fs);
+            gyro_lsb = 131.0f / (1 << sample.gyro_fs);
+            ax = ax_raw / accel_lsb;
+            ay = ay_raw / accel_lsb;
+            az = az_raw / accel_lsb;
+            gx = (gx_raw / gyro_lsb) - gyro_bias_x;
+            gy = (gy_raw / gyro_lsb) - gyro_bias_y;
+            gz = (gz_raw / gyro_lsb) - gyro_bias_z;
             temp_c = temp_raw / 340.0f + 36.53f;
 
             // --- 死区设置 (防止静止时的微小漂移) ---
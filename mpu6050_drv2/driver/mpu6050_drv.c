@@ -2,88 +2,1101 @@
 #include <linux/init.h>
 #include <linux/fs.h>
 #include <linux/cdev.h>
+#include <linux/device.h>
 #include <linux/uaccess.h>
 #include <linux/i2c.h>
 #include <linux/interrupt.h> // 中断核心头文件
 #include <linux/wait.h>      // 等待队列头文件
 #include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/poll.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h> // mmap 环形缓冲区
+#include <linux/timekeeping.h>
+#include <linux/hrtimer.h>
+#include <linux/list.h>
+#include <linux/log2.h>
+#if IS_ENABLED(CONFIG_IIO_TRIGGERED_BUFFER)
+#include <linux/iio/iio.h> // IIO 后端 (内核未开启 IIO 时自动去掉)
+#include <linux/iio/buffer.h>
+#include <linux/iio/trigger.h>
+#include <linux/iio/trigger_consumer.h>
+#include <linux/iio/triggered_buffer.h>
+#endif
 
 #define DRIVER_NAME "mpu6050"
 
 // MPU6050 寄存器
 #define REG_SMPLRT_DIV      0x19
 #define REG_CONFIG          0x1A
+#define REG_GYRO_CONFIG     0x1B  // 陀螺仪量程 FS_SEL (bit4:3)
+#define REG_ACCEL_CONFIG    0x1C  // 加速度计量程 AFS_SEL (bit4:3)
+#define REG_FIFO_EN         0x23  // 选择写入片上 FIFO 的数据
 #define REG_INT_PIN_CFG     0x37  // 中断引脚配置
 #define REG_INT_ENABLE      0x38  // 中断使能
 #define REG_INT_STATUS      0x3A  // 中断状态
 #define REG_ACCEL_XOUT_H    0x3B
+#define REG_USER_CTRL       0x6A  // FIFO 使能/复位
 #define REG_PWR_MGMT_1      0x6B
+#define REG_FIFO_COUNTH     0x72  // FIFO 字节数 (高字节在前)
+#define REG_FIFO_R_W        0x74  // FIFO 数据端口，连续读即连续出队
 #define REG_WHO_AM_I        0x75
 
+// 寄存器位定义
+#define FIFO_EN_ALL         0xF8  // TEMP | XG | YG | ZG | ACCEL，顺序与 0x3B~0x48 一致
+#define USER_CTRL_FIFO_EN   0x40
+#define USER_CTRL_FIFO_RST  0x04
+#define INT_FIFO_OFLOW      0x10
+#define INT_DATA_RDY        0x01
+
+#define MPU6050_FRAME_SIZE  14    // ACCEL(6) + TEMP(2) + GYRO(6)
+#define MPU6050_READ_BATCH  16    // read() 每次从共享环取出的最大样本数 (栈上中转)
+
+// 上电默认配置: 100Hz, DLPF 44Hz, ±250dps, ±2g
+#define MPU6050_DEFAULT_RATE 100
+#define MPU6050_DEFAULT_DLPF 3
+#define MPU6050_GYRO_RATE    1000  // DLPF 打开 (1~6) 时的陀螺仪输出频率 (Hz)
+#define MPU6050_GYRO_RATE_NOLPF 8000 // DLPF 关闭 (0) 时的陀螺仪输出频率 (Hz)
+#define MPU6050_DLPF_MAX     6
+#define MPU6050_FS_MAX       3     // 量程档位 0~3
+
+// 片上 FIFO: 1024 字节，最多容纳 73 个完整帧
+#define MPU6050_HW_FIFO_SIZE   1024
+#define MPU6050_HW_FIFO_FRAMES (MPU6050_HW_FIFO_SIZE / MPU6050_FRAME_SIZE)
+// 每个读出周期最多积累半个 FIFO，另一半留给 fifo_work 的调度延迟
+#define MPU6050_FIFO_MAX_DRAIN (MPU6050_HW_FIFO_FRAMES / 2)
+// 每个 I2C 读消息的最大长度 (8 帧)，所有分块放进同一次 i2c_transfer
+#define MPU6050_FIFO_CHUNK     (8 * MPU6050_FRAME_SIZE)
+#define MPU6050_FIFO_MSGS      (2 * DIV_ROUND_UP(MPU6050_HW_FIFO_FRAMES * MPU6050_FRAME_SIZE, \
+                                                 MPU6050_FIFO_CHUNK))
+
+// 共享样本历史的深度 (帧)，向上取整到 2 的幂；每个读者最多可以落后这么多帧
+static unsigned int fifo_depth = 64;
+module_param(fifo_depth, uint, 0444);
+MODULE_PARM_DESC(fifo_depth, "Samples of history shared by all readers (rounded up to power of 2)");
+
+// 片上 FIFO 突发读取模式：关闭数据就绪中断，按水位周期性批量读出
+static bool hw_fifo;
+module_param(hw_fifo, bool, 0444);
+MODULE_PARM_DESC(hw_fifo, "Use the MPU6050 on-chip FIFO and drain it in bursts");
+
+static unsigned int fifo_watermark = 20;
+module_param(fifo_watermark, uint, 0444);
+MODULE_PARM_DESC(fifo_watermark, "Frames accumulated in the on-chip FIFO before each burst drain (1-36)");
+
+/* --- mmap 共享环形缓冲区 (用户态需保持一致) ---
+ * 映射布局: [第 0 页: mpu6050_ring_hdr][第 1 页起: mpu6050_sample × nr_samples]，只读映射
+ * head 和各消费者的 tail 是自由增长的 32 位计数，槽位为 head & (nr_samples - 1)
+ * 每个消费者在本地维护自己的 tail，多个消费者互不影响；用户态消费流程:
+ *   1. h = head (读后加 acquire 屏障)
+ *   2. 若 h - tail > nr_samples，说明已被覆盖，tail = h - nr_samples
+ *   3. 拷贝 tail 对应的样本，再次读 head，若 head - tail > nr_samples 则该样本已被改写，丢弃
+ *   4. tail++，一批消费完后用 MPU6050_IOC_SET_TAIL 告知驱动，poll() 以 head != tail 判断可读
+ */
+#define MPU6050_RING_MAGIC   0x4D505552 // "MPUR"
+#define MPU6050_RING_VERSION 3
+
+struct mpu6050_ring_hdr
+{
+    __u32 magic;
+    __u32 version;
+    __u32 nr_samples;  // 样本槽数量 (2 的幂)
+    __u32 sample_size; // sizeof(struct mpu6050_sample)
+    __u32 data_offset; // 第一个样本相对映射起点的偏移
+    __u32 head;        // 生产者: 已写入样本总数，只由驱动更新
+    __u32 reserved[2]; // 版本 2 中的共享 tail，已改为每个文件各自的游标
+};
+
+struct mpu6050_sample
+{
+    __u64 timestamp_ns;             // CLOCK_BOOTTIME 采样时间 (硬中断时刻)
+    __u8 data[MPU6050_FRAME_SIZE];  // 原始大端帧
+    __u8 accel_fs;                  // 采样时的加速度量程: ±(2 << accel_fs) g
+    __u8 gyro_fs;                   // 采样时的陀螺仪量程: ±(250 << gyro_fs) dps
+};
+
+/* 读者统计，按打开的文件分别计数 */
+struct mpu6050_stats
+{
+    __u64 overruns;     // 本读者落后超过历史深度而错过的样本数
+    __u64 hw_overflows; // 片上 FIFO 溢出次数 (整个设备)
+    __u32 queued;       // 本读者尚未读取的样本数
+    __u32 depth;        // 共享历史的深度
+};
+
+/* 运行时配置 */
+struct mpu6050_config
+{
+    __u16 rate_hz;  // 输出数据率，写入时按分频取最接近的值，读出为实际值
+    __u8 dlpf;      // DLPF_CFG 0~6 (0 = 关闭，陀螺仪 8kHz)
+    __u8 gyro_fs;   // 0~3: ±250/500/1000/2000 dps
+    __u8 accel_fs;  // 0~3: ±2/4/8/16 g
+    __u8 reserved[3];
+};
+
+/* 读者唤醒策略: 攒够 watermark 个样本才唤醒，但最旧的未读样本等待不超过 max_latency_us
+ * 默认 {1, 0}，即每个样本都唤醒；max_latency_us = 0 表示只按水位唤醒
+ */
+struct mpu6050_wakeup
+{
+    __u32 watermark;      // 1 ~ 历史深度
+    __u32 max_latency_us; // 0 = 不限制
+};
+
+/* --- ioctl 接口 (用户态需保持一致) --- */
+#define MPU6050_IOC_MAGIC       'M'
+#define MPU6050_IOC_SET_FORMAT  _IOW(MPU6050_IOC_MAGIC, 1, __u32)
+#define MPU6050_IOC_GET_FORMAT  _IOR(MPU6050_IOC_MAGIC, 2, __u32)
+#define MPU6050_IOC_SET_CONFIG  _IOW(MPU6050_IOC_MAGIC, 3, struct mpu6050_config)
+#define MPU6050_IOC_GET_CONFIG  _IOR(MPU6050_IOC_MAGIC, 4, struct mpu6050_config)
+#define MPU6050_IOC_GET_STATS   _IOR(MPU6050_IOC_MAGIC, 5, struct mpu6050_stats)
+#define MPU6050_IOC_SET_WAKEUP  _IOW(MPU6050_IOC_MAGIC, 6, struct mpu6050_wakeup)
+#define MPU6050_IOC_GET_WAKEUP  _IOR(MPU6050_IOC_MAGIC, 7, struct mpu6050_wakeup)
+#define MPU6050_IOC_SET_TAIL    _IOW(MPU6050_IOC_MAGIC, 8, __u32) // mmap 消费者已消费到的位置
+
+// read() 输出格式，按打开的文件分别设置
+#define MPU6050_FMT_RAW         0 // 14 字节原始帧 (默认，兼容旧程序)
+#define MPU6050_FMT_SAMPLE      1 // struct mpu6050_sample，带硬中断时间戳
+
 struct mpu6050_dev
 {
     dev_t dev_id;
     struct cdev cdev;
     struct class *class;
-    struct device *device;
+    struct device device; // 引用计数管理本结构，仍然打开的文件关闭之前不会释放
     struct i2c_client *client;
+    bool dead;            // 设备已解绑，仍然打开的文件只能得到 -ENODEV；受 ring_lock 保护
 
     // --- 中断相关 ---
     int irq;                   // 中断号
     wait_queue_head_t read_wq; // 等待队列
-    int data_ready;            // 数据就绪标志位 (1:有数据, 0:无数据)
+    u64 irq_ts;                // 硬中断时刻 (CLOCK_BOOTTIME ns)，由 Primary Handler 记录
+
+
+    // --- 运行时配置 ---
+    struct mutex hw_lock;               // 串行化采样读取、FIFO 复位和配置切换
+    struct mpu6050_config cfg;          // 当前生效的配置，受 hw_lock 保护
+    u8 int_enable;                      // 正常工作时 INT_ENABLE 的值
+
+    // --- 片上 FIFO 模式 ---
+    bool hw_fifo;                       // 是否工作在 FIFO 突发读取模式
+    struct delayed_work fifo_work;      // 按水位周期读出 FIFO
+    unsigned long fifo_period;          // 读出周期 (jiffies)
+    unsigned long hw_overflows;         // 片上 FIFO 溢出次数
+    u8 *fifo_buf;                       // 突发读取的目标缓冲，只在 FIFO 模式下分配
+    u64 period_ns;                      // 采样周期，用于推算 FIFO 中各帧的时间
+
+    // --- 共享样本历史 (vmalloc_user 分配，read() 和 mmap 共用) ---
+    // 驱动只写不删，每个读者用自己的游标读取，互不影响
+    spinlock_t ring_lock;             // 保护样本槽的写入与读者拷贝
+    u32 head;                         // 已写入样本总数 (驱动私有副本，不信任共享页)
+    void *ring_mem;
+    size_t ring_bytes;
+    struct mpu6050_ring_hdr *ring;    // 指向 ring_mem 第 0 页
+    struct mpu6050_sample *samples;   // 指向 ring_mem 第 1 页
+    u32 ring_mask;
+
+    // --- 读者唤醒合并 ---
+    // 生产者按每个读者自己的水位判断是否唤醒；hrtimer 按各读者最旧未读样本的最大延迟期限取最早者
+    struct mutex files_lock;              // 保护 def_wakeup，并串行化 files 链表的增删
+    struct list_head files;               // 所有打开的文件，增删同时持有 ring_lock，生产者在 ring_lock 下遍历
+    struct mpu6050_wakeup def_wakeup;     // 新打开文件的默认唤醒策略 (sysfs 可调)
+    struct hrtimer wake_timer;            // 最早的延迟期限到期时唤醒读者
+    u64 wake_expires;                     // wake_timer 当前的期限，0 = 未启动，受 ring_lock 保护
+
+#if IS_ENABLED(CONFIG_IIO_TRIGGERED_BUFFER)
+    // --- IIO 后端 ---
+    struct iio_dev *indio_dev;
+    struct iio_trigger *trig;     // 数据就绪触发器
+    const u8 *iio_data;           // 本次触发对应的帧 (触发处理函数同步执行，期间有效)
+    unsigned int iio_count;
+    u64 iio_ts_last;
+#endif
+};
+
+/* 每个打开的文件各自的状态 */
+struct mpu6050_file
+{
+    struct mpu6050_dev *mpu;
+    u32 format;   // read() 输出格式 MPU6050_FMT_*
+    u32 cursor;   // 下一个要读的样本序号 (mmap 消费者的 tail)，受 ring_lock 保护
+    u64 overruns; // 落后太多而被覆盖的样本数
+    struct list_head node;          // 挂在 mpu->files 上
+    struct mpu6050_wakeup wakeup;   // 本读者的唤醒策略，受 ring_lock 保护
+    u64 latency_ns;                 // wakeup.max_latency_us 换算成 ns
 };
 
+/* 所有读者中最早的、还没到的最大延迟期限，0 = 没有，调用者需持有 ring_lock
+ * 只有设置了最大延迟、有未读样本但还没攒够自己水位的读者才计入，期限从它最旧的未读样本算起
+ */
+static u64 mpu6050_next_deadline(struct mpu6050_dev *mpu, u64 now)
+{
+    struct mpu6050_file *mf;
+    u64 next = 0, deadline;
+    u32 avail;
+
+    list_for_each_entry(mf, &mpu->files, node)
+    {
+        avail = mpu->head - mf->cursor;
+        if (!mf->latency_ns || avail == 0 || avail >= mf->wakeup.watermark)
+            continue;
+        // 未攒够水位时 avail 小于历史深度，最旧的未读槽位有效
+        deadline = mpu->samples[mf->cursor & mpu->ring_mask].timestamp_ns + mf->latency_ns;
+        if (deadline > now && (!next || deadline < next))
+            next = deadline;
+    }
+    return next;
+}
+
+/* 按最早的延迟期限 (重新) 启动唤醒定时器，调用者需持有 ring_lock
+ * 没有期限时不取消已启动的定时器，多余的一次到期只会让读者重新判断条件
+ */
+static void mpu6050_arm_wake_timer(struct mpu6050_dev *mpu)
+{
+    u64 next;
+
+    // 解绑之后定时器已经 (或即将) 被取消，不能再启动
+    if (mpu->dead)
+        return;
+
+    next = mpu6050_next_deadline(mpu, ktime_get_boottime_ns());
+
+    if (next && next != mpu->wake_expires)
+    {
+        mpu->wake_expires = next;
+        hrtimer_start(&mpu->wake_timer, ns_to_ktime(next), HRTIMER_MODE_ABS);
+    }
+}
+
+/* 把 n 帧连续数据追加到共享样本历史，最旧的槽位被覆盖
+ * ts_last 是最后一帧的采样时间，之前的帧按采样周期往前推算
+ * 调用者需持有 hw_lock，保证帧上标记的量程就是采样时的量程
+ */
+static void mpu6050_push_frames(struct mpu6050_dev *mpu, const u8 *data, unsigned int n,
+                                u64 ts_last)
+{
+    struct mpu6050_sample sample = {
+        .accel_fs = mpu->cfg.accel_fs,
+        .gyro_fs = mpu->cfg.gyro_fs,
+    };
+    struct mpu6050_file *mf;
+    unsigned long flags;
+    unsigned int i;
+    bool wake = false;
+    u64 first, now;
+    u32 head, before, after;
+
+    if (n == 0)
+        return;
+
+    spin_lock_irqsave(&mpu->ring_lock, flags);
+    head = mpu->head;
+    first = ts_last - (u64)(n - 1) * mpu->period_ns;
+    for (i = 0; i < n; i++)
+    {
+        sample.timestamp_ns = first + (u64)i * mpu->period_ns;
+        memcpy(sample.data, data + i * MPU6050_FRAME_SIZE, MPU6050_FRAME_SIZE);
+        mpu->samples[(head + i) & mpu->ring_mask] = sample;
+    }
+    // 样本内容写完后再发布 head，用户态看到新 head 时数据一定已经可见
+    smp_wmb();
+    WRITE_ONCE(mpu->head, head + n);
+    WRITE_ONCE(mpu->ring->head, head + n);
+
+    // 唤醒合并: 有读者这次跨过了自己的水位才唤醒；
+    // 读者原本没有未读样本、而新的最旧样本 (FIFO 批量往前推算的时间戳) 已经超过它的最大延迟，也立即唤醒
+    now = ktime_get_boottime_ns();
+    list_for_each_entry(mf, &mpu->files, node)
+    {
+        before = head - mf->cursor;
+        after = before + n;
+        if (before < mf->wakeup.watermark && after >= mf->wakeup.watermark)
+            wake = true;
+        else if (before == 0 && mf->latency_ns && now >= first + mf->latency_ns)
+            wake = true;
+    }
+    // 其余读者按各自最旧未读样本的期限由定时器兜底
+    mpu6050_arm_wake_timer(mpu);
+    spin_unlock_irqrestore(&mpu->ring_lock, flags);
+
+    if (wake)
+        wake_up_interruptible(&mpu->read_wq);
+}
+
+/* 最早的延迟期限到期: 唤醒读者各自判断，再按剩下的期限重新启动 */
+static enum hrtimer_restart mpu6050_wake_timer(struct hrtimer *timer)
+{
+    struct mpu6050_dev *mpu = container_of(timer, struct mpu6050_dev, wake_timer);
+    unsigned long flags;
+
+    spin_lock_irqsave(&mpu->ring_lock, flags);
+    mpu->wake_expires = 0;
+    mpu6050_arm_wake_timer(mpu);
+    spin_unlock_irqrestore(&mpu->ring_lock, flags);
+
+    wake_up_interruptible(&mpu->read_wq);
+    return HRTIMER_NORESTART;
+}
+
+#if IS_ENABLED(CONFIG_IIO_TRIGGERED_BUFFER)
+/* --- IIO 触发缓冲后端 ---
+ * 通道顺序与 14 字节帧一致，scan 数据直接就是原始帧 + 时间戳，
+ * libiio / iio_readdev 可以通过标准的 buffer 接口批量读取
+ */
+enum mpu6050_scan_index
+{
+    MPU6050_SCAN_ACCEL_X,
+    MPU6050_SCAN_ACCEL_Y,
+    MPU6050_SCAN_ACCEL_Z,
+    MPU6050_SCAN_TEMP,
+    MPU6050_SCAN_GYRO_X,
+    MPU6050_SCAN_GYRO_Y,
+    MPU6050_SCAN_GYRO_Z,
+    MPU6050_SCAN_TIMESTAMP,
+};
+
+#define MPU6050_IIO_SCAN_TYPE                                                                      \
+    {                                                                                              \
+        .sign = 's', .realbits = 16, .storagebits = 16, .endianness = IIO_BE,                      \
+    }
+
+#define MPU6050_IIO_CHAN(_type, _mod, _index)                                                      \
+    {                                                                                              \
+        .type = _type, .modified = 1, .channel2 = _mod, .address = _index,                         \
+        .info_mask_separate = BIT(IIO_CHAN_INFO_RAW),                                              \
+        .info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE), .scan_index = _index,                \
+        .scan_type = MPU6050_IIO_SCAN_TYPE,                                                        \
+    }
+
+static const struct iio_chan_spec mpu6050_iio_channels[] = {
+    MPU6050_IIO_CHAN(IIO_ACCEL, IIO_MOD_X, MPU6050_SCAN_ACCEL_X),
+    MPU6050_IIO_CHAN(IIO_ACCEL, IIO_MOD_Y, MPU6050_SCAN_ACCEL_Y),
+    MPU6050_IIO_CHAN(IIO_ACCEL, IIO_MOD_Z, MPU6050_SCAN_ACCEL_Z),
+    {
+        .type = IIO_TEMP,
+        .address = MPU6050_SCAN_TEMP,
+        .info_mask_separate =
+            BIT(IIO_CHAN_INFO_RAW) | BIT(IIO_CHAN_INFO_SCALE) | BIT(IIO_CHAN_INFO_OFFSET),
+        .scan_index = MPU6050_SCAN_TEMP,
+        .scan_type = MPU6050_IIO_SCAN_TYPE,
+    },
+    MPU6050_IIO_CHAN(IIO_ANGL_VEL, IIO_MOD_X, MPU6050_SCAN_GYRO_X),
+    MPU6050_IIO_CHAN(IIO_ANGL_VEL, IIO_MOD_Y, MPU6050_SCAN_GYRO_Y),
+    MPU6050_IIO_CHAN(IIO_ANGL_VEL, IIO_MOD_Z, MPU6050_SCAN_GYRO_Z),
+    IIO_CHAN_SOFT_TIMESTAMP(MPU6050_SCAN_TIMESTAMP),
+};
+
+// 总是整帧采集，用户只打开部分通道时由 IIO core 拆分
+static const unsigned long mpu6050_iio_scan_masks[] = {GENMASK(MPU6050_SCAN_GYRO_Z, 0), 0};
+
+static int mpu6050_iio_read_raw(struct iio_dev *indio_dev, struct iio_chan_spec const *chan,
+                                int *val, int *val2, long mask)
+{
+    struct mpu6050_dev *mpu = *(struct mpu6050_dev **)iio_priv(indio_dev);
+    int ret;
+
+    switch (mask)
+    {
+    case IIO_CHAN_INFO_RAW:
+        // 缓冲采集进行中时不允许单次读取
+        ret = iio_device_claim_direct_mode(indio_dev);
+        if (ret)
+            return ret;
+        // 与配置切换、FIFO 读出互斥
+        mutex_lock(&mpu->hw_lock);
+        ret = i2c_smbus_read_word_swapped(mpu->client, REG_ACCEL_XOUT_H + chan->address * 2);
+        mutex_unlock(&mpu->hw_lock);
+        iio_device_release_direct_mode(indio_dev);
+        if (ret < 0)
+            return ret;
+        *val = (s16)ret;
+        return IIO_VAL_INT;
+
+    case IIO_CHAN_INFO_SCALE:
+        switch (chan->type)
+        {
+        case IIO_ACCEL: // ±2g: 9.80665 / 16384 m/s^2 per LSB，量程每升一档翻倍
+            *val = 0;
+            *val2 = 598550 << READ_ONCE(mpu->cfg.accel_fs);
+            return IIO_VAL_INT_PLUS_NANO;
+        case IIO_ANGL_VEL: // ±250dps: (1 / 131) * PI / 180 rad/s per LSB
+            *val = 0;
+            *val2 = 133231 << READ_ONCE(mpu->cfg.gyro_fs);
+            return IIO_VAL_INT_PLUS_NANO;
+        case IIO_TEMP: // 1000 / 340 m°C per LSB
+            *val = 2;
+            *val2 = 941176;
+            return IIO_VAL_INT_PLUS_MICRO;
+        default:
+            return -EINVAL;
+        }
+
+    case IIO_CHAN_INFO_OFFSET: // 36.53°C * 340 LSB/°C
+        *val = 12420;
+        *val2 = 200000;
+        return IIO_VAL_INT_PLUS_MICRO;
+
+    default:
+        return -EINVAL;
+    }
+}
+
+static const struct iio_info mpu6050_iio_info = {
+    .read_raw = mpu6050_iio_read_raw,
+};
+
+/* 触发处理函数 (线程上下文)
+ * 用自己的数据就绪触发器时，帧已经由中断线程/FIFO 读出，这里只搬运，不再访问总线；
+ * 用其他触发器 (如 hrtimer trigger) 时现场读一帧 (持有 hw_lock)
+ */
+static irqreturn_t mpu6050_iio_trigger_handler(int irq, void *p)
+{
+    struct iio_poll_func *pf = p;
+    struct iio_dev *indio_dev = pf->indio_dev;
+    struct mpu6050_dev *mpu = *(struct mpu6050_dev **)iio_priv(indio_dev);
+    struct
+    {
+        u8 data[MPU6050_FRAME_SIZE];
+        s64 ts __aligned(8);
+    } scan;
+    s64 iio_now, boot_now;
+    unsigned int i;
+    int ret;
+
+    if (iio_trigger_using_own(indio_dev))
+    {
+        // 样本时间戳是 CLOCK_BOOTTIME，换算到 IIO 当前选择的时钟
+        iio_now = iio_get_time_ns(indio_dev);
+        boot_now = ktime_get_boottime_ns();
+        for (i = 0; i < mpu->iio_count; i++)
+        {
+            memcpy(scan.data, mpu->iio_data + i * MPU6050_FRAME_SIZE, MPU6050_FRAME_SIZE);
+            scan.ts = iio_now - (boot_now - (s64)(mpu->iio_ts_last -
+                                                 (u64)(mpu->iio_count - 1 - i) * mpu->period_ns));
+            iio_push_to_buffers_with_timestamp(indio_dev, &scan, scan.ts);
+        }
+    }
+    else
+    {
+        mutex_lock(&mpu->hw_lock);
+        ret = i2c_smbus_read_i2c_block_data(mpu->client, REG_ACCEL_XOUT_H,
+                                            MPU6050_FRAME_SIZE, scan.data);
+        mutex_unlock(&mpu->hw_lock);
+        if (ret == MPU6050_FRAME_SIZE)
+            iio_push_to_buffers_with_timestamp(indio_dev, &scan,
+                                               pf->timestamp ?: iio_get_time_ns(indio_dev));
+    }
+
+    iio_trigger_notify_done(indio_dev->trig);
+    return IRQ_HANDLED;
+}
+
+/* 中断线程/FIFO 读出新帧后调用，buffer 未打开时什么都不做 */
+static void mpu6050_iio_push(struct mpu6050_dev *mpu, const u8 *data, unsigned int n,
+                             u64 ts_last)
+{
+    if (!mpu->indio_dev || !iio_buffer_enabled(mpu->indio_dev))
+        return;
+
+    mpu->iio_data = data;
+    mpu->iio_count = n;
+    mpu->iio_ts_last = ts_last;
+    // 在当前线程中同步执行所有挂在该触发器上的处理函数
+    iio_trigger_poll_chained(mpu->trig);
+}
+
+static int mpu6050_iio_register(struct mpu6050_dev *mpu)
+{
+    struct device *dev = &mpu->client->dev;
+    struct iio_dev *indio_dev;
+    int ret;
+
+    indio_dev = devm_iio_device_alloc(dev, sizeof(mpu));
+    if (!indio_dev)
+        return -ENOMEM;
+    *(struct mpu6050_dev **)iio_priv(indio_dev) = mpu;
+
+    indio_dev->name = DRIVER_NAME;
+    indio_dev->info = &mpu6050_iio_info;
+    indio_dev->modes = INDIO_DIRECT_MODE;
+    indio_dev->channels = mpu6050_iio_channels;
+    indio_dev->num_channels = ARRAY_SIZE(mpu6050_iio_channels);
+    indio_dev->available_scan_masks = mpu6050_iio_scan_masks;
+
+    // 数据就绪触发器：由中断线程 (或 FIFO 读出) 驱动
+    mpu->trig = devm_iio_trigger_alloc(dev, "%s-dev%d", indio_dev->name,
+                                       iio_device_id(indio_dev));
+    if (!mpu->trig)
+        return -ENOMEM;
+    iio_trigger_set_drvdata(mpu->trig, mpu);
+    ret = devm_iio_trigger_register(dev, mpu->trig);
+    if (ret)
+        return ret;
+    indio_dev->trig = iio_trigger_get(mpu->trig);
+
+    ret = devm_iio_triggered_buffer_setup(dev, indio_dev, iio_pollfunc_store_time,
+                                          mpu6050_iio_trigger_handler, NULL);
+    if (ret)
+        return ret;
+
+    ret = devm_iio_device_register(dev, indio_dev);
+    if (ret)
+        return ret;
+
+    mpu->indio_dev = indio_dev;
+    return 0;
+}
+#else
+static inline void mpu6050_iio_push(struct mpu6050_dev *mpu, const u8 *data, unsigned int n,
+                                    u64 ts_last)
+{
+}
+
+static inline int mpu6050_iio_register(struct mpu6050_dev *mpu)
+{
+    return 0;
+}
+#endif
+
+/* 复位片上 FIFO 并重新开始缓存，调用者需持有 hw_lock */
+static void mpu6050_fifo_reset(struct mpu6050_dev *mpu)
+{
+    i2c_smbus_write_byte_data(mpu->client, REG_USER_CTRL, USER_CTRL_FIFO_RST);
+    i2c_smbus_write_byte_data(mpu->client, REG_USER_CTRL, USER_CTRL_FIFO_EN);
+}
+
+/* 读出片上 FIFO 中所有完整帧
+ * 先读 FIFO_COUNT，再把 "写寄存器地址 + 读 N 字节" 按块拼成一组消息，
+ * 通过一次 i2c_transfer 读完，避免每帧都走一遍总线事务
+ */
+static int mpu6050_fifo_drain(struct mpu6050_dev *mpu)
+{
+    struct i2c_client *client = mpu->client;
+    struct i2c_msg msgs[MPU6050_FIFO_MSGS];
+    u8 reg = REG_FIFO_R_W;
+    u8 cnt[2];
+    unsigned int count, frames, off, len;
+    u64 ts;
+    int nmsgs = 0;
+    int ret;
+
+    ret = i2c_smbus_read_i2c_block_data(client, REG_FIFO_COUNTH, 2, cnt);
+    if (ret != 2)
+        return ret < 0 ? ret : -EIO;
+
+    count = (cnt[0] << 8) | cnt[1];
+    if (count >= MPU6050_HW_FIFO_SIZE)
+    {
+        // 已经溢出，帧边界无法确定，只能丢弃重来
+        mpu6050_fifo_reset(mpu);
+        mpu->hw_overflows++;
+        return -EOVERFLOW;
+    }
+
+    // 只取完整帧，剩余的半帧留到下次
+    frames = count / MPU6050_FRAME_SIZE;
+    if (frames == 0)
+        return 0;
+    count = frames * MPU6050_FRAME_SIZE;
+
+    for (off = 0; off < count; off += len)
+    {
+        len = min_t(unsigned int, count - off, MPU6050_FIFO_CHUNK);
+
+        msgs[nmsgs].addr = client->addr;
+        msgs[nmsgs].flags = 0;
+        msgs[nmsgs].len = 1;
+        msgs[nmsgs].buf = &reg;
+        nmsgs++;
+
+        msgs[nmsgs].addr = client->addr;
+        msgs[nmsgs].flags = I2C_M_RD;
+        msgs[nmsgs].len = len;
+        msgs[nmsgs].buf = mpu->fifo_buf + off;
+        nmsgs++;
+    }
+
+    ret = i2c_transfer(client->adapter, msgs, nmsgs);
+    if (ret != nmsgs)
+        return ret < 0 ? ret : -EIO;
+
+    // FIFO 中最后一帧近似为读出时刻的采样
+    ts = ktime_get_boottime_ns();
+    mpu6050_push_frames(mpu, mpu->fifo_buf, frames, ts);
+    mpu6050_iio_push(mpu, mpu->fifo_buf, frames, ts);
+    return frames;
+}
+
+static void mpu6050_fifo_work(struct work_struct *work)
+{
+    struct mpu6050_dev *mpu = container_of(to_delayed_work(work), struct mpu6050_dev, fifo_work);
+
+    mutex_lock(&mpu->hw_lock);
+    mpu6050_fifo_drain(mpu);
+    mutex_unlock(&mpu->hw_lock);
+
+    schedule_delayed_work(&mpu->fifo_work, mpu->fifo_period);
+}
+
+/* FIFO 读出周期 (jiffies)
+ * MPU6050 没有 FIFO 水位中断 (只有溢出中断)，水位通过定时读出来实现：
+ * 每 fifo_watermark 个采样周期读一次，单次事务读出约 fifo_watermark 帧；向下取整，至少 1 个 jiffy
+ */
+static unsigned long mpu6050_fifo_period(unsigned int rate_hz)
+{
+    unsigned int wm = clamp(fifo_watermark, 1U, (unsigned int)MPU6050_FIFO_MAX_DRAIN);
+
+    return max_t(unsigned long, wm * HZ / rate_hz, 1);
+}
+
+/* FIFO 模式能否承受该采样率: 一个读出周期内积累的帧不能超过 MPU6050_FIFO_MAX_DRAIN
+ * 周期至少 1 个 jiffy，所以最高采样率为 MPU6050_FIFO_MAX_DRAIN * HZ (HZ=100 时 3600Hz)
+ */
+static bool mpu6050_fifo_sustainable(unsigned int rate_hz)
+{
+    return (u64)rate_hz * mpu6050_fifo_period(rate_hz) <= (u64)MPU6050_FIFO_MAX_DRAIN * HZ;
+}
+
+/* 根据当前配置更新采样周期和 FIFO 读出周期 */
+static void mpu6050_update_timing(struct mpu6050_dev *mpu)
+{
+    mpu->period_ns = div_u64(NSEC_PER_SEC, mpu->cfg.rate_hz);
+    mpu->fifo_period = mpu6050_fifo_period(mpu->cfg.rate_hz);
+}
+
+/* 陀螺仪输出频率和分频值，实际采样率 = base / (1 + div) */
+static unsigned int mpu6050_rate_base(const struct mpu6050_config *cfg)
+{
+    return cfg->dlpf ? MPU6050_GYRO_RATE : MPU6050_GYRO_RATE_NOLPF;
+}
+
+static unsigned int mpu6050_rate_div(const struct mpu6050_config *cfg)
+{
+    return clamp(mpu6050_rate_base(cfg) / cfg->rate_hz, 1U, 256U) - 1;
+}
+
+static int mpu6050_check_config(struct mpu6050_dev *mpu, const struct mpu6050_config *cfg)
+{
+    if (cfg->rate_hz == 0 || cfg->dlpf > MPU6050_DLPF_MAX || cfg->gyro_fs > MPU6050_FS_MAX ||
+        cfg->accel_fs > MPU6050_FS_MAX)
+        return -EINVAL;
+    // FIFO 模式下按实际采样率检查，来不及读出的组合直接拒绝，不让 FIFO 每个周期都溢出
+    if (mpu->hw_fifo &&
+        !mpu6050_fifo_sustainable(mpu6050_rate_base(cfg) / (1 + mpu6050_rate_div(cfg))))
+        return -EINVAL;
+    return 0;
+}
+
+/* 把配置写入传感器寄存器，调用者需持有 hw_lock */
+static int mpu6050_write_config(struct mpu6050_dev *mpu, const struct mpu6050_config *cfg)
+{
+    struct i2c_client *client = mpu->client;
+    unsigned int base = mpu6050_rate_base(cfg);
+    unsigned int div = mpu6050_rate_div(cfg); // 采样率 = base / (1 + div)
+    int ret;
+
+    ret = i2c_smbus_write_byte_data(client, REG_SMPLRT_DIV, div);
+    if (!ret)
+        ret = i2c_smbus_write_byte_data(client, REG_CONFIG, cfg->dlpf);
+    if (!ret)
+        ret = i2c_smbus_write_byte_data(client, REG_GYRO_CONFIG, cfg->gyro_fs << 3);
+    if (!ret)
+        ret = i2c_smbus_write_byte_data(client, REG_ACCEL_CONFIG, cfg->accel_fs << 3);
+    if (ret)
+        return ret;
+
+    mpu->cfg = *cfg;
+    mpu->cfg.rate_hz = base / (1 + div);
+    memset(mpu->cfg.reserved, 0, sizeof(mpu->cfg.reserved));
+    mpu6050_update_timing(mpu);
+    return 0;
+}
+
+/* 运行时切换配置，调用者需持有 hw_lock
+ * 切换期间关闭中断：旧配置下的帧 (含 FIFO 中残留的) 先按旧量程入队，
+ * 切换后清掉中断状态和 FIFO，之后入队的帧一定是新配置下的采样
+ */
+static int mpu6050_set_config(struct mpu6050_dev *mpu, const struct mpu6050_config *cfg)
+{
+    struct i2c_client *client = mpu->client;
+    int ret;
+
+    ret = mpu6050_check_config(mpu, cfg);
+    if (ret)
+        return ret;
+
+    i2c_smbus_write_byte_data(client, REG_INT_ENABLE, 0x00);
+    if (mpu->hw_fifo)
+        mpu6050_fifo_drain(mpu);
+
+    ret = mpu6050_write_config(mpu, cfg);
+
+    if (mpu->hw_fifo)
+        mpu6050_fifo_reset(mpu);
+    i2c_smbus_read_byte_data(client, REG_INT_STATUS);
+    i2c_smbus_write_byte_data(client, REG_INT_ENABLE, mpu->int_enable);
+
+    return ret;
+}
+
+/* 中断处理 Top Half (硬中断上下文)
+ * 只记录中断到达的时间，这是最接近传感器完成转换的时刻；
+ * 之后线程调度、I2C 读取带来的延迟都不会进入时间戳
+ */
+static irqreturn_t mpu6050_irq_handler(int irq, void *dev_id)
+{
+    struct mpu6050_dev *mpu = dev_id;
+
+    WRITE_ONCE(mpu->irq_ts, ktime_get_boottime_ns());
+    return IRQ_WAKE_THREAD;
+}
+
 /* 中断处理 Bottom Half (Threaded IRQ)
  * 运行在内核线程中，允许睡眠 (I2C 读写)
+ * INT_STATUS (0x3A) 与数据寄存器 (0x3B~0x48) 地址连续，一次 15 字节的块读同时完成
+ * "清中断 + 取数据"，帧在中断时刻被捕获并放进共享历史，read() 只做拷贝，从不访问总线
+ * 中断线以 IRQF_SHARED 申请，上半部无法判断中断来源，由这里读状态寄存器判断：
+ * 本设备没有待处理的事件时返回 IRQ_NONE，交给共享同一根线的其它设备
  */
 static irqreturn_t mpu6050_irq_thread(int irq, void *dev_id)
 {
     struct mpu6050_dev *mpu = dev_id;
+    u8 buf[1 + MPU6050_FRAME_SIZE]; // [INT_STATUS][ACCEL][TEMP][GYRO]
+    u64 ts;
+    int status;
+    int ret;
 
-    // 读取状态寄存器，清除中断标志
-    // 虽然设置了 INT_RD_CLEAR，但这里显式读取更保险，能防止中断卡住
-    i2c_smbus_read_byte_data(mpu->client, REG_INT_STATUS);
+    // 与配置切换互斥，切换完成前的中断会在这里等待
+    mutex_lock(&mpu->hw_lock);
 
-    // 1. 设置标志位
-    mpu->data_ready = 1;
+    // FIFO 模式下只打开了溢出中断，数据由 fifo_work 批量读出，这里只需读状态
+    if (mpu->hw_fifo)
+    {
+        status = i2c_smbus_read_byte_data(mpu->client, REG_INT_STATUS);
+        if (status >= 0 && !(status & INT_FIFO_OFLOW))
+        {
+            mutex_unlock(&mpu->hw_lock);
+            return IRQ_NONE;
+        }
+        if (status > 0)
+        {
+            mpu6050_fifo_reset(mpu);
+            mpu->hw_overflows++;
+        }
+        mutex_unlock(&mpu->hw_lock);
+        return IRQ_HANDLED;
+    }
 
-    // 2. 唤醒在 read 函数中睡觉的进程
-    wake_up_interruptible(&mpu->read_wq);
+    // 1. 一次事务读出状态和整帧数据，时间戳取硬中断时刻
+    ts = READ_ONCE(mpu->irq_ts);
+    ret = i2c_smbus_read_i2c_block_data(mpu->client, REG_INT_STATUS, sizeof(buf), buf);
+
+    // 总线出错时无法判断来源，按本设备的中断处理
+    if (ret != sizeof(buf))
+    {
+        mutex_unlock(&mpu->hw_lock);
+        return IRQ_HANDLED;
+    }
+
+    // DATA_RDY 为 0: 共享线上其它设备的中断，或配置切换时状态已被清除、切换前挂起的中断，丢弃这帧
+    if (!(buf[0] & INT_DATA_RDY))
+    {
+        mutex_unlock(&mpu->hw_lock);
+        return IRQ_NONE;
+    }
+
+    // 2. 写入共享历史，按唤醒策略唤醒在 read 函数中睡觉的进程
+    mpu6050_push_frames(mpu, buf + 1, 1, ts);
+    mpu6050_iio_push(mpu, buf + 1, 1, ts);
+    mutex_unlock(&mpu->hw_lock);
 
     return IRQ_HANDLED;
 }
 
+/* 本读者是否有未读样本 (无锁快速判断) */
+static bool mpu6050_has_data(struct mpu6050_file *mf)
+{
+    return READ_ONCE(mf->mpu->head) != READ_ONCE(mf->cursor);
+}
+
+/* 游标为 cursor 的读者是否应该被唤醒 (无锁判断):
+ * 攒够本读者的水位，或最旧的未读样本已经等待超过本读者的最大延迟
+ */
+static bool mpu6050_ready(struct mpu6050_file *mf, u32 cursor)
+{
+    struct mpu6050_dev *mpu = mf->mpu;
+    u32 avail = READ_ONCE(mpu->head) - cursor;
+    u64 oldest;
+
+    if (avail == 0)
+        return false;
+    if (avail >= mf->wakeup.watermark)
+        return true;
+    if (!mf->latency_ns)
+        return false;
+
+    // 未攒够水位时 avail 小于历史深度，最旧的未读槽位不会正在被覆盖
+    smp_rmb();
+    oldest = READ_ONCE(mpu->samples[cursor & mpu->ring_mask].timestamp_ns);
+    return ktime_get_boottime_ns() - oldest >= mf->latency_ns;
+}
+
+static int mpu6050_check_wakeup(struct mpu6050_dev *mpu, const struct mpu6050_wakeup *wk)
+{
+    if (wk->watermark == 0 || wk->watermark > mpu->ring_mask + 1)
+        return -EINVAL;
+    return 0;
+}
+
+/* 修改本读者的唤醒策略: 按新的期限重启唤醒定时器，条件放宽后可能已经满足，让读者重新判断 */
+static void mpu6050_update_wakeup(struct mpu6050_file *mf, const struct mpu6050_wakeup *wk)
+{
+    struct mpu6050_dev *mpu = mf->mpu;
+    unsigned long flags;
+
+    spin_lock_irqsave(&mpu->ring_lock, flags);
+    mf->wakeup = *wk;
+    mf->latency_ns = (u64)wk->max_latency_us * NSEC_PER_USEC;
+    mpu6050_arm_wake_timer(mpu);
+    spin_unlock_irqrestore(&mpu->ring_lock, flags);
+
+    wake_up_interruptible(&mpu->read_wq);
+}
+
+/* 从本读者的游标处取出最多 max 个样本
+ * 落后超过历史深度时，被覆盖的部分计入本读者的 overruns，游标跳到最旧的有效样本
+ */
+static unsigned int mpu6050_fetch(struct mpu6050_file *mf, struct mpu6050_sample *out,
+                                  unsigned int max)
+{
+    struct mpu6050_dev *mpu = mf->mpu;
+    unsigned long flags;
+    unsigned int i, n;
+    u32 avail;
+
+    spin_lock_irqsave(&mpu->ring_lock, flags);
+    avail = mpu->head - mf->cursor;
+    if (avail > mpu->ring_mask + 1)
+    {
+        mf->overruns += avail - (mpu->ring_mask + 1);
+        mf->cursor = mpu->head - (mpu->ring_mask + 1);
+        avail = mpu->ring_mask + 1;
+    }
+
+    n = min(avail, max);
+    for (i = 0; i < n; i++)
+        out[i] = mpu->samples[(mf->cursor + i) & mpu->ring_mask];
+    mf->cursor += n;
+    if (n)
+        mpu6050_arm_wake_timer(mpu);
+    spin_unlock_irqrestore(&mpu->ring_lock, flags);
+
+    return n;
+}
+
 static ssize_t mpu6050_read(struct file *filp, char __user *buf, size_t len, loff_t *off)
 {
-    struct mpu6050_dev *mpu = filp->private_data;
-    u8 data[14];
+    struct mpu6050_file *mf = filp->private_data;
+    struct mpu6050_dev *mpu = mf->mpu;
+    struct mpu6050_sample batch[MPU6050_READ_BATCH];
+    size_t unit = mf->format == MPU6050_FMT_SAMPLE ? sizeof(struct mpu6050_sample)
+                                                   : MPU6050_FRAME_SIZE;
+    size_t want = len / unit; // 用户缓冲区能放下的整帧数
+    size_t done = 0;
+    unsigned int n, i;
     int ret;
 
-    if (len != 14)
+    if (want == 0)
         return -EINVAL;
 
-    // --- 阻塞等待 ---
-    // wait_event_interruptible 宏解析：
-    // 如果 data_ready 为 0，进程进入休眠，让出 CPU。
-    // 当 wake_up 被调用且 data_ready 变为 1 时，进程被唤醒继续往下走。
-    ret = wait_event_interruptible(mpu->read_wq, mpu->data_ready != 0);
-    if (ret)
-        return -ERESTARTSYS; // 被信号打断 (如 Ctrl+C)
+    // 同一个 fd 被多个线程读取时，被唤醒后样本可能已经被别的线程取走；
+    // 返回 0 会被当成文件结束，所以一个都没取到时重新等待 (非阻塞模式返回 -EAGAIN)
+    while (done == 0)
+    {
+        if (READ_ONCE(mpu->dead))
+            return -ENODEV;
 
-    // --- 醒来干活 ---
-    mpu->data_ready = 0; // 清除标志位
+        if (filp->f_flags & O_NONBLOCK)
+        {
+            // 非阻塞模式下没有数据立即返回，由 poll/epoll 等待；有数据就直接读，不受水位限制
+            if (!mpu6050_has_data(mf))
+                return -EAGAIN;
+        }
+        else
+        {
+            // --- 阻塞等待 ---
+            // 进程休眠直到满足本读者的唤醒条件 (攒够水位或超过最大延迟)，之后一次取走所有样本
+            // 设备解绑时也会被唤醒，返回 -ENODEV
+            ret = wait_event_interruptible(mpu->read_wq,
+                                           mpu6050_ready(mf, READ_ONCE(mf->cursor)) ||
+                                               READ_ONCE(mpu->dead));
+            if (ret)
+                return -ERESTARTSYS; // 被信号打断 (如 Ctrl+C)
+            if (READ_ONCE(mpu->dead))
+                return -ENODEV;
+        }
+
+        // --- 一次系统调用取走尽可能多的整帧 ---
+        // copy_to_user 可能睡眠，不能在自旋锁内执行，所以分批中转
+        while (done < want)
+        {
+            n = mpu6050_fetch(mf, batch, min_t(size_t, want - done, MPU6050_READ_BATCH));
+            if (n == 0)
+                break;
+
+            // 原始格式只要 14 字节数据，原地向前压紧 (目标地址始终不超过源地址)
+            if (mf->format == MPU6050_FMT_RAW)
+            {
+                for (i = 0; i < n; i++)
+                    memmove((u8 *)batch + i * MPU6050_FRAME_SIZE, batch[i].data,
+                            MPU6050_FRAME_SIZE);
+            }
+
+            if (copy_to_user(buf + done * unit, batch, n * unit))
+                return done ? done * unit : -EFAULT;
 
-    // 读取数据 (I2C Block Read)
-    ret = i2c_smbus_read_i2c_block_data(mpu->client, REG_ACCEL_XOUT_H, 14, data);
-    if (ret < 0)
-        return -EIO;
+            done += n;
+        }
+    }
+
+    return done * unit;
+}
+
+static long mpu6050_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+    struct mpu6050_file *mf = filp->private_data;
+    struct mpu6050_dev *mpu = mf->mpu;
+    u32 __user *uarg = (u32 __user *)arg;
+    struct mpu6050_config cfg;
+    struct mpu6050_stats stats = {};
+    struct mpu6050_wakeup wk;
+    unsigned long flags;
+    u32 val;
+    int ret;
 
-    // 拷贝给用户
-    if (copy_to_user(buf, data, 14))
-        return -EFAULT;
+    // 解绑之后不再访问总线，也不再修改唤醒策略
+    if (READ_ONCE(mpu->dead))
+        return -ENODEV;
 
-    return 14;
+    switch (cmd)
+    {
+    case MPU6050_IOC_SET_FORMAT:
+        if (get_user(val, uarg))
+            return -EFAULT;
+        if (val != MPU6050_FMT_RAW && val != MPU6050_FMT_SAMPLE)
+            return -EINVAL;
+        mf->format = val;
+        return 0;
+
+    case MPU6050_IOC_GET_FORMAT:
+        return put_user(mf->format, uarg);
+
+    case MPU6050_IOC_SET_CONFIG:
+        if (copy_from_user(&cfg, (void __user *)arg, sizeof(cfg)))
+            return -EFAULT;
+        mutex_lock(&mpu->hw_lock);
+        ret = mpu6050_set_config(mpu, &cfg);
+        mutex_unlock(&mpu->hw_lock);
+        return ret;
+
+    case MPU6050_IOC_GET_CONFIG:
+        mutex_lock(&mpu->hw_lock);
+        cfg = mpu->cfg;
+        mutex_unlock(&mpu->hw_lock);
+        return copy_to_user((void __user *)arg, &cfg, sizeof(cfg)) ? -EFAULT : 0;
+
+    case MPU6050_IOC_GET_STATS:
+        spin_lock_irqsave(&mpu->ring_lock, flags);
+        stats.overruns = mf->overruns;
+        stats.queued = min(mpu->head - mf->cursor, mpu->ring_mask + 1);
+        spin_unlock_irqrestore(&mpu->ring_lock, flags);
+        stats.hw_overflows = mpu->hw_overflows;
+        stats.depth = mpu->ring_mask + 1;
+        return copy_to_user((void __user *)arg, &stats, sizeof(stats)) ? -EFAULT : 0;
+
+    case MPU6050_IOC_SET_WAKEUP:
+        if (copy_from_user(&wk, (void __user *)arg, sizeof(wk)))
+            return -EFAULT;
+        ret = mpu6050_check_wakeup(mpu, &wk);
+        if (ret)
+            return ret;
+        mpu6050_update_wakeup(mf, &wk);
+        return 0;
+
+    case MPU6050_IOC_SET_TAIL:
+        if (get_user(val, uarg))
+            return -EFAULT;
+        spin_lock_irqsave(&mpu->ring_lock, flags);
+        // 不能超过 head；落后超过历史深度的部分在下一次读取或 poll 时计入 overruns
+        ret = (s32)(val - mpu->head) > 0 ? -EINVAL : 0;
+        if (!ret)
+        {
+            mf->cursor = val;
+            // 最旧的未读样本变了，本读者的延迟期限随之改变
+            mpu6050_arm_wake_timer(mpu);
+        }
+        spin_unlock_irqrestore(&mpu->ring_lock, flags);
+        if (!ret)
+            wake_up_interruptible(&mpu->read_wq);
+        return ret;
+
+    case MPU6050_IOC_GET_WAKEUP:
+        // 与 mpu6050_update_wakeup 的写入同在 ring_lock 下
+        spin_lock_irqsave(&mpu->ring_lock, flags);
+        wk = mf->wakeup;
+        spin_unlock_irqrestore(&mpu->ring_lock, flags);
+        return copy_to_user((void __user *)arg, &wk, sizeof(wk)) ? -EFAULT : 0;
+
+    default:
+        return -ENOTTY;
+    }
+}
+
+/* poll/select/epoll 支持
+ * 把 read_wq 登记到 poll 表中，中断线程 wake_up 时 epoll 循环会被唤醒
+ * 设备解绑后返回 EPOLLHUP | EPOLLERR
+ */
+static __poll_t mpu6050_poll(struct file *filp, struct poll_table_struct *wait)
+{
+    struct mpu6050_file *mf = filp->private_data;
+    struct mpu6050_dev *mpu = mf->mpu;
+
+    poll_wait(filp, &mpu->read_wq, wait);
+
+    if (READ_ONCE(mpu->dead))
+        return EPOLLHUP | EPOLLERR;
+
+    // mmap 消费者通过 MPU6050_IOC_SET_TAIL 推进同一个游标，唤醒条件与 read() 相同
+    if (mpu6050_ready(mf, READ_ONCE(mf->cursor)))
+        return EPOLLIN | EPOLLRDNORM;
+
+    return 0;
+}
+
+/* 把整个共享环形缓冲区只读映射到用户态
+ * 第 0 页是头部 (head)，之后是样本数组，用户态可直接消费，无需逐个样本的系统调用；
+ * 所有读者共享同一份样本，不允许任何映射改写头部和样本
+ */
+static int mpu6050_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+    struct mpu6050_file *mf = filp->private_data;
+    struct mpu6050_dev *mpu = mf->mpu;
+    unsigned long size = vma->vm_end - vma->vm_start;
+
+    if (READ_ONCE(mpu->dead))
+        return -ENODEV;
+    if (vma->vm_pgoff != 0 || size > mpu->ring_bytes)
+        return -EINVAL;
+    if (vma->vm_flags & VM_WRITE)
+        return -EPERM;
+
+    // 之后也不能通过 mprotect 改成可写
+    vma->vm_flags &= ~VM_MAYWRITE;
+    return remap_vmalloc_range(vma, mpu->ring_mem, 0);
 }
 
 static int mpu6050_open(struct inode *inode, struct file *filp)
@@ -92,26 +1105,240 @@ static int mpu6050_open(struct inode *inode, struct file *filp)
     // 我们需要获取包含这个 cdev 的整个 mpu6050_dev 结构
     // 通过结构提成员反推结构体地址的 container_of 宏来实现
     struct mpu6050_dev *mpu = container_of(inode->i_cdev, struct mpu6050_dev, cdev);
-    filp->private_data = mpu;
+    struct mpu6050_file *mf;
+    unsigned long flags;
+
+    if (READ_ONCE(mpu->dead))
+        return -ENODEV;
+
+    mf = kzalloc(sizeof(*mf), GFP_KERNEL);
+    if (!mf)
+        return -ENOMEM;
+
+    mf->mpu = mpu;
+    filp->private_data = mf;
+
+    // 生产者在 ring_lock 下遍历 files 链表，增删时两把锁都要持有
+    mutex_lock(&mpu->files_lock);
+    mf->wakeup = mpu->def_wakeup;
+    mf->latency_ns = (u64)mf->wakeup.max_latency_us * NSEC_PER_USEC;
+    spin_lock_irqsave(&mpu->ring_lock, flags);
+    // 新读者从当前位置开始，只看到打开之后的样本
+    mf->cursor = mpu->head;
+    list_add(&mf->node, &mpu->files);
+    spin_unlock_irqrestore(&mpu->ring_lock, flags);
+    mutex_unlock(&mpu->files_lock);
+    return 0;
+}
+
+static int mpu6050_release(struct inode *inode, struct file *filp)
+{
+    struct mpu6050_file *mf = filp->private_data;
+    struct mpu6050_dev *mpu = mf->mpu;
+    unsigned long flags;
+
+    // 走掉的读者的期限留在定时器上也无妨，到期时按剩下的读者重新计算
+    // 设备解绑之后本结构也还在: 每个打开的文件通过 cdev 持有 mpu->device 的引用
+    mutex_lock(&mpu->files_lock);
+    spin_lock_irqsave(&mpu->ring_lock, flags);
+    list_del(&mf->node);
+    spin_unlock_irqrestore(&mpu->ring_lock, flags);
+    mutex_unlock(&mpu->files_lock);
+
+    kfree(mf);
     return 0;
 }
 
 static const struct file_operations mpu6050_fops = {
     .owner = THIS_MODULE,
     .open = mpu6050_open,
+    .release = mpu6050_release,
     .read = mpu6050_read,
+    .unlocked_ioctl = mpu6050_ioctl,
+    .poll = mpu6050_poll,
+    .mmap = mpu6050_mmap,
+};
+
+/* --- sysfs 配置接口 ---
+ * 每个属性只修改配置中的一项，读-改-写在 hw_lock 内完成
+ */
+enum mpu6050_attr_field
+{
+    MPU6050_ATTR_RATE,
+    MPU6050_ATTR_DLPF,
+    MPU6050_ATTR_GYRO_RANGE,
+    MPU6050_ATTR_ACCEL_RANGE,
+};
+
+/* 量程值 -> 档位，base << fs == val；不合法时返回一个会被 mpu6050_check_config 拒绝的值 */
+static u8 mpu6050_range_to_fs(unsigned int val, unsigned int base)
+{
+    u8 fs;
+
+    for (fs = 0; fs <= MPU6050_FS_MAX; fs++)
+    {
+        if (val == base << fs)
+            return fs;
+    }
+    return MPU6050_FS_MAX + 1;
+}
+
+static ssize_t mpu6050_attr_show(struct mpu6050_dev *mpu, enum mpu6050_attr_field field, char *buf)
+{
+    struct mpu6050_config cfg;
+
+    mutex_lock(&mpu->hw_lock);
+    cfg = mpu->cfg;
+    mutex_unlock(&mpu->hw_lock);
+
+    switch (field)
+    {
+    case MPU6050_ATTR_RATE:
+        return sysfs_emit(buf, "%u\n", cfg.rate_hz);
+    case MPU6050_ATTR_DLPF:
+        return sysfs_emit(buf, "%u\n", cfg.dlpf);
+    case MPU6050_ATTR_GYRO_RANGE:
+        return sysfs_emit(buf, "%u\n", 250U << cfg.gyro_fs);
+    case MPU6050_ATTR_ACCEL_RANGE:
+        return sysfs_emit(buf, "%u\n", 2U << cfg.accel_fs);
+    }
+    return -EINVAL;
+}
+
+static ssize_t mpu6050_attr_store(struct mpu6050_dev *mpu, enum mpu6050_attr_field field,
+                                  const char *buf, size_t count)
+{
+    struct mpu6050_config cfg;
+    unsigned int val;
+    int ret;
+
+    ret = kstrtouint(buf, 0, &val);
+    if (ret)
+        return ret;
+
+    mutex_lock(&mpu->hw_lock);
+    cfg = mpu->cfg;
+    switch (field)
+    {
+    case MPU6050_ATTR_RATE:
+        cfg.rate_hz = min(val, (unsigned int)U16_MAX);
+        break;
+    case MPU6050_ATTR_DLPF:
+        cfg.dlpf = min(val, 0xFFU);
+        break;
+    case MPU6050_ATTR_GYRO_RANGE: // 250/500/1000/2000
+        cfg.gyro_fs = mpu6050_range_to_fs(val, 250);
+        break;
+    case MPU6050_ATTR_ACCEL_RANGE: // 2/4/8/16
+        cfg.accel_fs = mpu6050_range_to_fs(val, 2);
+        break;
+    }
+    ret = mpu6050_set_config(mpu, &cfg);
+    mutex_unlock(&mpu->hw_lock);
+
+    return ret ? ret : count;
+}
+
+#define MPU6050_CFG_ATTR(_name, _field)                                                            \
+    static ssize_t _name##_show(struct device *dev, struct device_attribute *attr, char *buf)      \
+    {                                                                                              \
+        return mpu6050_attr_show(dev_get_drvdata(dev), _field, buf);                               \
+    }                                                                                              \
+    static ssize_t _name##_store(struct device *dev, struct device_attribute *attr,                \
+                                 const char *buf, size_t count)                                    \
+    {                                                                                              \
+        return mpu6050_attr_store(dev_get_drvdata(dev), _field, buf, count);                       \
+    }                                                                                              \
+    static DEVICE_ATTR_RW(_name)
+
+MPU6050_CFG_ATTR(sample_rate, MPU6050_ATTR_RATE);
+MPU6050_CFG_ATTR(dlpf, MPU6050_ATTR_DLPF);
+MPU6050_CFG_ATTR(gyro_range, MPU6050_ATTR_GYRO_RANGE);
+MPU6050_CFG_ATTR(accel_range, MPU6050_ATTR_ACCEL_RANGE);
+
+/* 新打开文件的默认唤醒策略，已打开的文件不受影响 (各自用 MPU6050_IOC_SET_WAKEUP 修改) */
+static ssize_t wakeup_watermark_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct mpu6050_dev *mpu = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%u\n", READ_ONCE(mpu->def_wakeup.watermark));
+}
+
+static ssize_t wakeup_watermark_store(struct device *dev, struct device_attribute *attr,
+                                      const char *buf, size_t count)
+{
+    struct mpu6050_dev *mpu = dev_get_drvdata(dev);
+    struct mpu6050_wakeup wk;
+    int ret;
+
+    mutex_lock(&mpu->files_lock);
+    wk = mpu->def_wakeup;
+    ret = kstrtouint(buf, 0, &wk.watermark);
+    if (!ret)
+        ret = mpu6050_check_wakeup(mpu, &wk);
+    if (!ret)
+        mpu->def_wakeup = wk;
+    mutex_unlock(&mpu->files_lock);
+
+    return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(wakeup_watermark);
+
+static ssize_t wakeup_latency_us_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct mpu6050_dev *mpu = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%u\n", READ_ONCE(mpu->def_wakeup.max_latency_us));
+}
+
+static ssize_t wakeup_latency_us_store(struct device *dev, struct device_attribute *attr,
+                                       const char *buf, size_t count)
+{
+    struct mpu6050_dev *mpu = dev_get_drvdata(dev);
+    unsigned int val;
+    int ret;
+
+    ret = kstrtouint(buf, 0, &val);
+    if (ret)
+        return ret;
+
+    mutex_lock(&mpu->files_lock);
+    mpu->def_wakeup.max_latency_us = val;
+    mutex_unlock(&mpu->files_lock);
+
+    return count;
+}
+static DEVICE_ATTR_RW(wakeup_latency_us);
+
+static struct attribute *mpu6050_attrs[] = {
+    &dev_attr_sample_rate.attr,
+    &dev_attr_dlpf.attr,
+    &dev_attr_gyro_range.attr,
+    &dev_attr_accel_range.attr,
+    &dev_attr_wakeup_watermark.attr,
+    &dev_attr_wakeup_latency_us.attr,
+    NULL,
 };
+ATTRIBUTE_GROUPS(mpu6050);
 
-static int mpu6050_init_hw(struct i2c_client *client)
+static int mpu6050_init_hw(struct mpu6050_dev *mpu)
 {
+    struct i2c_client *client = mpu->client;
+    const struct mpu6050_config def = {
+        .rate_hz = MPU6050_DEFAULT_RATE, // 1kHz / (1+9) = 100Hz
+        .dlpf = MPU6050_DEFAULT_DLPF,    // DLPF (数字低通滤波), Bandwidth 44Hz
+        .gyro_fs = 0,                    // ±250dps
+        .accel_fs = 0,                   // ±2g
+    };
+    int ret;
+
     // 1. 复位/唤醒
     i2c_smbus_write_byte_data(client, REG_PWR_MGMT_1, 0x00);
 
-    // 2. 设置采样率 (比如 1kHz / (1+9) = 100Hz)
-    i2c_smbus_write_byte_data(client, REG_SMPLRT_DIV, 9);
-
-    // 3. 配置 DLPF (数字低通滤波), Bandwidth 44Hz
-    i2c_smbus_write_byte_data(client, REG_CONFIG, 0x03);
+    // 2~3. 采样率、DLPF 和量程，量程必须显式设置，不能依赖上电默认值
+    ret = mpu6050_write_config(mpu, &def);
+    if (ret)
+        return ret;
 
     // --- 4. 中断配置 (关键) ---
     // 0x37 INT_PIN_CFG:
@@ -130,33 +1357,210 @@ static int mpu6050_init_hw(struct i2c_client *client)
     return 0;
 }
 
+/* 打开片上 FIFO 并启动周期读出 (周期由 mpu6050_update_timing 计算) */
+static void mpu6050_fifo_enable(struct mpu6050_dev *mpu)
+{
+    struct i2c_client *client = mpu->client;
+
+    i2c_smbus_write_byte_data(client, REG_FIFO_EN, 0x00);
+    mpu6050_fifo_reset(mpu);
+    i2c_smbus_write_byte_data(client, REG_FIFO_EN, FIFO_EN_ALL);
+
+    schedule_delayed_work(&mpu->fifo_work, mpu->fifo_period);
+}
+
+/* 关闭芯片中断并停止 FIFO 读出
+ * 在申请中断之后登记，devm 逆序释放: 先停止产生新数据，再释放中断，最后才注销 IIO 设备
+ */
+static void mpu6050_stop_hw(void *data)
+{
+    struct mpu6050_dev *mpu = data;
+
+    mutex_lock(&mpu->hw_lock);
+    i2c_smbus_write_byte_data(mpu->client, REG_INT_ENABLE, 0x00);
+    mutex_unlock(&mpu->hw_lock);
+    cancel_delayed_work_sync(&mpu->fifo_work);
+}
+
+static void mpu6050_cancel_wake_timer(void *data)
+{
+    struct mpu6050_dev *mpu = data;
+
+    hrtimer_cancel(&mpu->wake_timer);
+}
+
+/* 最后一个引用 (设备本身或仍然打开的文件) 释放时调用
+ * 已映射的页面由 VMA 持有引用，vfree 后在 munmap 时才真正释放
+ */
+static void mpu6050_dev_release(struct device *device)
+{
+    struct mpu6050_dev *mpu = container_of(device, struct mpu6050_dev, device);
+
+    vfree(mpu->ring_mem);
+    kfree(mpu);
+}
+
+/* 在 probe 开头登记，devm 逆序释放，最后才放掉设备本身的引用:
+ * 中断、FIFO 读出、定时器和 IIO 设备都已经停止，之后只剩打开的文件会访问本结构
+ */
+static void mpu6050_put_dev(void *data)
+{
+    struct mpu6050_dev *mpu = data;
+
+    put_device(&mpu->device);
+}
+
+/* 分配共享样本历史: 1 页头部 + nr 个样本槽，read() 和 mmap 共用
+ * 与本结构一起由 mpu6050_dev_release 释放，解绑之后仍然打开的文件还能安全访问
+ */
+static int mpu6050_alloc_ring(struct mpu6050_dev *mpu, unsigned int nr)
+{
+    nr = roundup_pow_of_two(max(nr, 2U));
+    mpu->ring_bytes = PAGE_SIZE + PAGE_ALIGN(nr * sizeof(struct mpu6050_sample));
+
+    // vmalloc_user 分配的内存已清零，并允许 remap_vmalloc_range 映射到用户态
+    mpu->ring_mem = vmalloc_user(mpu->ring_bytes);
+    if (!mpu->ring_mem)
+        return -ENOMEM;
+
+    mpu->ring = mpu->ring_mem;
+    mpu->samples = mpu->ring_mem + PAGE_SIZE;
+    mpu->ring_mask = nr - 1;
+
+    mpu->ring->magic = MPU6050_RING_MAGIC;
+    mpu->ring->version = MPU6050_RING_VERSION;
+    mpu->ring->nr_samples = nr;
+    mpu->ring->sample_size = sizeof(struct mpu6050_sample);
+    mpu->ring->data_offset = PAGE_SIZE;
+
+    return 0;
+}
+
+/* 注册字符设备 /dev/mpu6050，运行时配置通过 /sys/class/mpu6050/mpu6050/ 下的属性文件调整 */
+static int mpu6050_add_chrdev(struct mpu6050_dev *mpu)
+{
+    int ret;
+
+    ret = alloc_chrdev_region(&mpu->dev_id, 0, 1, DRIVER_NAME);
+    if (ret)
+        return ret;
+
+    mpu->class = class_create(THIS_MODULE, DRIVER_NAME);
+    if (IS_ERR(mpu->class))
+    {
+        ret = PTR_ERR(mpu->class);
+        goto fail_region;
+    }
+
+    mpu->device.class = mpu->class;
+    mpu->device.devt = mpu->dev_id;
+    mpu->device.groups = mpu6050_groups;
+    ret = dev_set_name(&mpu->device, DRIVER_NAME);
+    if (ret)
+        goto fail_class;
+
+    // cdev 持有 mpu->device 的引用，打开的文件关闭之前本结构不会被释放
+    cdev_init(&mpu->cdev, &mpu6050_fops);
+    mpu->cdev.owner = THIS_MODULE;
+    ret = cdev_device_add(&mpu->cdev, &mpu->device);
+    if (ret)
+        goto fail_class;
+    return 0;
+
+fail_class:
+    class_destroy(mpu->class);
+fail_region:
+    unregister_chrdev_region(mpu->dev_id, 1);
+    return ret;
+}
+
+static void mpu6050_del_chrdev(struct mpu6050_dev *mpu)
+{
+    cdev_device_del(&mpu->cdev, &mpu->device);
+    class_destroy(mpu->class);
+    unregister_chrdev_region(mpu->dev_id, 1);
+}
+
 static int mpu6050_probe(struct i2c_client *client, const struct i2c_device_id *id)
 {
     struct mpu6050_dev *mpu;
     int ret;
 
     // 1. 申请内存
-    // devm_kzalloc 是 设备资源托管 的内存分配函数，会自动在设备移除时释放内存。
-    mpu = devm_kzalloc(&client->dev, sizeof(*mpu), GFP_KERNEL);
+    // 本结构由 mpu->device 的引用计数管理，不能用 devm: 设备移除后仍然打开的文件还会访问它
+    mpu = kzalloc(sizeof(*mpu), GFP_KERNEL);
+    if (!mpu)
+        return -ENOMEM;
+    device_initialize(&mpu->device);
+    mpu->device.parent = &client->dev;
+    mpu->device.release = mpu6050_dev_release;
+    dev_set_drvdata(&mpu->device, mpu);
+    // 从这里开始出错时由 devm 调用 put_device 释放
+    ret = devm_add_action_or_reset(&client->dev, mpu6050_put_dev, mpu);
+    if (ret)
+        return ret;
+
     // 保存I2C客户端指针
     mpu->client = client;
     // 将私有数据保存到client中
     i2c_set_clientdata(client, mpu);
 
-    // 2. 初始化等待队列
+    // 2. 初始化等待队列和采样缓冲
     init_waitqueue_head(&mpu->read_wq);
+    spin_lock_init(&mpu->ring_lock);
+    mutex_init(&mpu->hw_lock);
+    INIT_DELAYED_WORK(&mpu->fifo_work, mpu6050_fifo_work);
+    mpu->hw_fifo = hw_fifo;
+    if (mpu->hw_fifo)
+    {
+        // 一次读出最多是 FIFO 中所有完整帧
+        mpu->fifo_buf = devm_kmalloc(&client->dev, MPU6050_HW_FIFO_FRAMES * MPU6050_FRAME_SIZE,
+                                     GFP_KERNEL);
+        if (!mpu->fifo_buf)
+            return -ENOMEM;
+    }
+    ret = mpu6050_alloc_ring(mpu, fifo_depth);
+    if (ret)
+        return ret;
+
+    // 唤醒合并，默认每个样本都唤醒
+    mutex_init(&mpu->files_lock);
+    INIT_LIST_HEAD(&mpu->files);
+    mpu->def_wakeup.watermark = 1;
+    // 采样时间戳是 CLOCK_BOOTTIME，定时器用同一时钟按绝对时间到期
+    hrtimer_init(&mpu->wake_timer, CLOCK_BOOTTIME, HRTIMER_MODE_ABS);
+    mpu->wake_timer.function = mpu6050_wake_timer;
+    // 在申请中断之前登记，devm 逆序释放，保证中断已释放后才取消定时器
+    ret = devm_add_action_or_reset(&client->dev, mpu6050_cancel_wake_timer, mpu);
+    if (ret)
+        return ret;
 
     // 3. 硬件初始化
-    mpu6050_init_hw(client);
+    ret = mpu6050_init_hw(mpu);
+    if (ret)
+    {
+        dev_err(&client->dev, "Failed to init MPU6050: %d\n", ret);
+        return ret;
+    }
 
-    // 4. 注册字符设备 (略写，参考之前代码)
-    alloc_chrdev_region(&mpu->dev_id, 0, 1, DRIVER_NAME);
-    cdev_init(&mpu->cdev, &mpu6050_fops);
-    cdev_add(&mpu->cdev, mpu->dev_id, 1);
-    mpu->class = class_create(THIS_MODULE, DRIVER_NAME);
-    mpu->device = device_create(mpu->class, NULL, mpu->dev_id, NULL, DRIVER_NAME);
+    // 4. 注册字符设备
+    ret = mpu6050_add_chrdev(mpu);
+    if (ret)
+    {
+        dev_err(&client->dev, "Failed to register char device: %d\n", ret);
+        return ret;
+    }
 
-    // 5. 申请中断 (核心)
+    // 5. 注册 IIO 设备 (/sys/bus/iio/devices/iio:deviceX)
+    // 必须在申请中断、启动 FIFO 读出之前: 之后中断线程和 fifo_work 随时会推送到 IIO
+    ret = mpu6050_iio_register(mpu);
+    if (ret)
+    {
+        dev_err(&client->dev, "Failed to register IIO device: %d\n", ret);
+        goto fail_chrdev;
+    }
+
+    // 6. 申请中断 (核心)
     // client->irq 会由内核自动解析 DTS 填入
     if (client->irq)
     {
@@ -168,40 +1572,69 @@ static int mpu6050_probe(struct i2c_client *client, const struct i2c_device_id *
         // IRQF_TRIGGER_FALLING: 下降沿触发 (配合 Active Low)
         // IRQF_ONESHOT: Threaded IRQ 必须加
         ret = devm_request_threaded_irq(&client->dev, mpu->irq,
-                                        NULL,               // Primary handler (内核默认)
-                                        mpu6050_irq_thread, // Thread handler
+                                        mpu6050_irq_handler, // Primary handler (记录时间戳)
+                                        mpu6050_irq_thread,  // Thread handler
                                         IRQF_TRIGGER_FALLING | IRQF_ONESHOT | IRQF_SHARED,
                                         DRIVER_NAME,
                                         mpu);
         if (ret)
         {
             dev_err(&client->dev, "Failed to request IRQ: %d\n", ret);
-            return ret;
+            goto fail_chrdev;
         }
+    }
+    else if (!mpu->hw_fifo)
+    {
+        // FIFO 模式靠定时读出，可以没有中断线；逐帧模式必须有
+        dev_err(&client->dev, "No IRQ provided in DTS\n");
+        ret = -EINVAL;
+        goto fail_chrdev;
+    }
 
-        // 6. 最后一步：使能 MPU6050 内部中断
-        // 此时 IRQ handler 已经注册好，硬件也准备好了
-        i2c_smbus_write_byte_data(client, REG_INT_ENABLE, 0x01);
+    // 移除或之后出错时先关闭芯片中断、停止 FIFO 读出，再释放中断和 IIO 设备
+    ret = devm_add_action_or_reset(&client->dev, mpu6050_stop_hw, mpu);
+    if (ret)
+        goto fail_chrdev;
+
+    // 7. 最后一步：使能 MPU6050 内部中断
+    // 此时 IRQ handler 已经注册好，硬件也准备好了
+    if (mpu->hw_fifo)
+    {
+        mpu6050_fifo_enable(mpu);
+        mpu->int_enable = mpu->irq ? INT_FIFO_OFLOW : 0;
+        i2c_smbus_write_byte_data(client, REG_INT_ENABLE, mpu->int_enable);
+        dev_info(&client->dev, "On-chip FIFO mode, drain every %u ms\n",
+                 jiffies_to_msecs(mpu->fifo_period));
     }
     else
     {
-        dev_err(&client->dev, "No IRQ provided in DTS\n");
-        return -EINVAL;
+        mpu->int_enable = INT_DATA_RDY;
+        i2c_smbus_write_byte_data(client, REG_INT_ENABLE, mpu->int_enable);
     }
 
     dev_info(&client->dev, "MPU6050 Interrupt Driver Ready!\n");
     return 0;
+
+fail_chrdev:
+    mpu6050_del_chrdev(mpu);
+    return ret;
 }
 
 static void mpu6050_remove(struct i2c_client *client)
 {
-    // devm_request_irq 会自动释放中断
-    // 只需要销毁字符设备
+    // 关闭芯片中断、停止 FIFO 读出、释放中断、注销 IIO 设备和放掉设备引用都由 devm 按逆序完成
+    // 这里销毁字符设备，并让仍然打开的文件失效
     struct mpu6050_dev *mpu = i2c_get_clientdata(client);
-    device_destroy(mpu->class, mpu->dev_id);
-    class_destroy(mpu->class);
-    cdev_del(&mpu->cdev);
-    unregister_chrdev_region(mpu->dev_id, 1);
+    unsigned long flags;
+
+    // 之后不会再有新的 open
+    mpu6050_del_chrdev(mpu);
+
+    // 标记为 dead 之后不再启动唤醒定时器，阻塞的读者被唤醒后返回 -ENODEV
+    spin_lock_irqsave(&mpu->ring_lock, flags);
+    mpu->dead = true;
+    spin_unlock_irqrestore(&mpu->ring_lock, flags);
+    wake_up_interruptible(&mpu->read_wq);
 }
 
 // 设备树匹配表